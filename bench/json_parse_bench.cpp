@@ -0,0 +1,99 @@
+// 请求体解析的吞吐量：JsonDocument与原来基于正则的parse_simple_json对比，
+// 另测一个大文档的解析速度。用法：json_parse_bench [rounds]
+#include "json_document.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <regex>
+#include <string>
+
+using namespace std;
+
+// 原来的WebServer::parse_simple_json（每次调用都构造正则）
+static map<string, string> regex_params(const string& json_str) {
+    map<string, string> result;
+    if (json_str.empty() || json_str[0] != '{') {
+        return result;
+    }
+    string content = json_str.substr(1);
+    regex pattern("\\\"([^\\\"]+)\\\"\\s*:\\s*\\\"([^\\\"]*)\\\"");
+    smatch match;
+    string::const_iterator search_start(content.cbegin());
+    while (regex_search(search_start, content.cend(), match, pattern)) {
+        result[match[1].str()] = match[2].str();
+        search_start = match.suffix().first;
+    }
+    regex bool_pattern("\\\"([^\\\"]+)\\\"\\s*:\\s*(true|false|null|-?\\d+\\.?\\d*)");
+    search_start = content.cbegin();
+    while (regex_search(search_start, content.cend(), match, bool_pattern)) {
+        result[match[1].str()] = match[2].str();
+        search_start = match.suffix().first;
+    }
+    return result;
+}
+
+// 与webserver.cpp的json_params相同：顶层标量值
+static map<string, string> document_params(const string& json_str) {
+    map<string, string> params;
+    JsonDocument document;
+    if (!document.parse(json_str) || document.type(0) != JsonType::Object) {
+        return params;
+    }
+    for (size_t i = 1; i < document.end(0); i = document.end(i)) {
+        if (document.type(i) != JsonType::Array && document.type(i) != JsonType::Object) {
+            params[string(document.key(i))] = string(document.text(i));
+        }
+    }
+    return params;
+}
+
+template <class F>
+static double microseconds_per_call(int rounds, F&& f) {
+    const auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        f();
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    const int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    size_t sink = 0;
+
+    const string bodies[] = {
+        R"({"path":"/usr/share/doc","show_size":true,"max_depth":3,"sort":"size","threads":4,"size_units":"si","names_only":false})",
+        R"({"path":"/home/user/projects/web app","show_size":true,"human_readable":true,"max_depth":-1,)"
+        R"("exclude_patterns":["node_modules",".git","*.log","dist"],"sort":"natural","threads":8,)"
+        R"("client_id":"c-42","incremental":false})",
+    };
+    for (const string& body : bodies) {
+        const double regex_us = microseconds_per_call(rounds, [&] { sink += regex_params(body).size(); });
+        const double params_us = microseconds_per_call(rounds, [&] { sink += document_params(body).size(); });
+        JsonDocument document;
+        const double parse_us = microseconds_per_call(rounds, [&] {
+            document.parse(body);
+            sink += document.size();
+        });
+        printf("%4zu byte request: regex %.2f us, JsonDocument + params %.3f us, parse only %.3f us (%.0f MB/s)\n",
+               body.size(), regex_us, params_us, parse_us, body.size() / parse_us);
+    }
+
+    // 大文档：20万个对象，含转义字符串
+    string big = "[";
+    for (int i = 0; i < 200000; i++) {
+        big += i > 0 ? "," : "";
+        big += R"({"name":"file_)" + to_string(i) + R"(.txt","size":)" + to_string(i * 37) +
+               R"(,"tags":["a","b\n"],"ok":true})";
+    }
+    big += "]";
+    JsonDocument document;
+    const int big_rounds = max(1, rounds / 2000);
+    const double big_us = microseconds_per_call(big_rounds, [&] {
+        document.parse(big);
+        sink += document.size();
+    });
+    printf("%zu byte document, %zu values: %.0f MB/s\n", big.size(), document.size(), big.size() / big_us);
+
+    return sink == 0;
+}
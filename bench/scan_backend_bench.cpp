@@ -0,0 +1,81 @@
+// 扫描后端的速度：在临时目录中生成一棵本地树，分别用std::filesystem、getdents和io_uring后端扫描，
+// 只列名称（不stat）和带大小两种，1个线程和N个线程。先扫描一次预热页缓存，每种取多轮中的最短时间。
+// 用法：scan_backend_bench [文件数] [线程数] [轮数]
+#include "filesystem.hpp"
+#include "scan_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 每个目录kFilesPerDir个文件、kSubdirsPerDir个子目录，广度优先建到文件数够为止
+static void make_tree(const fs::path& root, size_t file_count) {
+    constexpr size_t kFilesPerDir = 40;
+    constexpr size_t kSubdirsPerDir = 8;
+    vector<fs::path> pending{root};
+    fs::create_directories(root);
+    size_t created = 0;
+    for (size_t next = 0; next < pending.size() && created < file_count; next++) {
+        const fs::path dir = pending[next];
+        for (size_t i = 0; i < kFilesPerDir && created < file_count; i++, created++) {
+            ofstream(dir / ("file_" + to_string(i) + ".dat")) << string(created % 4096, 'x');
+        }
+        for (size_t i = 0; i < kSubdirsPerDir; i++) {
+            pending.push_back(dir / ("dir_" + to_string(i)));
+            fs::create_directory(pending.back());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t file_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 40000;
+    const int threads = argc > 2 ? atoi(argv[2]) : max(2u, thread::hardware_concurrency());
+    const int rounds = argc > 3 ? atoi(argv[3]) : 5;
+
+    const fs::path root = fs::temp_directory_path() / ("scan_backend_bench_" + to_string(file_count));
+    fs::remove_all(root);
+    make_tree(root, file_count);
+
+    const struct {
+        const char* name;
+        ScanBackend backend;
+    } backends[] = {
+        {"std", ScanBackend::StdFilesystem},
+        {"getdents", ScanBackend::Getdents},
+        {"io_uring", ScanBackend::IoUring},
+    };
+
+    printf("%zu files under %s\n", file_count, root.string().c_str());
+    for (bool names_only : {true, false}) {
+        for (int thread_count : {1, threads}) {
+            for (const auto& backend : backends) {
+                FileTreeOptions options;
+                options.backend = backend.backend;
+                options.threads = thread_count;
+                options.names_only = names_only;
+
+                ScanStats stats;
+                FileSystemScanner::scan_directory(root.string(), options, &stats);  // 预热
+                double best = 0;
+                for (int round = 0; round < rounds; round++) {
+                    const auto start = chrono::steady_clock::now();
+                    ScanResult files = FileSystemScanner::scan_directory(root.string(), options, &stats);
+                    const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                    best = round == 0 ? ms : min(best, ms);
+                }
+                printf("%-10s %2d thread(s)  %-9s %8.1f ms  (%ju files, %ju dirs)\n",
+                       names_only ? "names only" : "with sizes", thread_count, backend.name, best,
+                       stats.totals.file_count, stats.totals.dir_count);
+            }
+        }
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,85 @@
+// 树形文本的生成速度：合成一棵树（每个目录50个文件），分别测不显示大小、人类可读大小和字节数三种输出。
+// 用法：tree_text_bench [文件数]
+#include "filesystem.hpp"
+#include "scan_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+static ScanResult make_tree(size_t file_count) {
+    constexpr size_t kFilesPerDir = 50;
+    constexpr size_t kDirsPerGroup = 400;
+    ScanResult result("/bench");
+    uint64_t seed = 88172645463325252ull;
+    auto next = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+
+    auto make_info = [](string name, const string& parent, bool is_directory, int depth) {
+        FileInfo info;
+        info.path = parent + "/" + name;
+        info.name = std::move(name);
+        info.is_directory = is_directory;
+        info.size = 0;
+        info.depth = depth;
+        return info;
+    };
+
+    const size_t dir_count = (file_count + kFilesPerDir - 1) / kFilesPerDir;
+    size_t files_left = file_count;
+    for (size_t group = 0; group * kDirsPerGroup < dir_count; group++) {
+        FileInfo group_info = make_info("group_" + to_string(group), "/bench", true, 1);
+        const uint32_t group_index = result.add(group_info, ScanResult::kNoParent);
+        SubtreeTotals group_totals;
+        for (size_t d = group * kDirsPerGroup; d < min(dir_count, (group + 1) * kDirsPerGroup); d++) {
+            FileInfo dir_info = make_info("dir_" + to_string(d), group_info.path, true, 2);
+            const uint32_t dir_index = result.add(dir_info, group_index);
+            SubtreeTotals totals;
+            for (size_t f = 0; f < kFilesPerDir && files_left > 0; f++, files_left--) {
+                FileInfo info = make_info("file_" + to_string(f) + ".dat", dir_info.path, false, 3);
+                // 大小在1 B到1 TB之间按数量级均匀分布
+                info.size = (next() & ((uint64_t(1) << (next() % 40 + 1)) - 1)) + 1;
+                info.last_in_directory = f + 1 == kFilesPerDir || files_left == 1;
+                totals.size += info.size;
+                totals.file_count += 1;
+                result.add(info, dir_index);
+            }
+            result.set_totals(dir_index, totals);
+            group_totals.add(totals);
+            group_totals.dir_count += 1;
+        }
+        result.set_totals(group_index, group_totals);
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const size_t file_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2400000;
+    const ScanResult files = make_tree(file_count);
+
+    struct Mode {
+        const char* name;
+        bool show_size;
+        bool human_readable;
+    } modes[] = {{"no sizes", false, true}, {"human sizes", true, true}, {"byte sizes", true, false}};
+
+    for (const Mode& mode : modes) {
+        FileTreeOptions options;
+        options.show_size = mode.show_size;
+        options.human_readable = mode.human_readable;
+        const auto start = chrono::steady_clock::now();
+        const string text = FileSystemScanner::generate_tree_text(files, options);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const size_t lines = static_cast<size_t>(count(text.begin(), text.end(), '\n'));
+        printf("%-12s %zu lines, %zu bytes: %.3f s (%.2f M lines/s)\n",
+               mode.name, lines, text.size(), seconds, lines / seconds / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// 大小和时间格式化的速度（每个值的纳秒数）：value_format.hpp的例程与原来的ostringstream、
+// snprintf和strftime对比。用法：value_format_bench [值的个数]
+#include "value_format.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 原来的FileSystemScanner::format_file_size
+static string stream_file_size(uintmax_t size) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit_index = 0;
+    double formatted_size = static_cast<double>(size);
+    while (formatted_size >= 1024.0 && unit_index < 4) {
+        formatted_size /= 1024.0;
+        unit_index++;
+    }
+    ostringstream stream;
+    stream << fixed << setprecision(2) << formatted_size << " " << units[unit_index];
+    return stream.str();
+}
+
+static size_t snprintf_file_size(char* out, uintmax_t size) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit_index = 0;
+    double formatted_size = static_cast<double>(size);
+    while (formatted_size >= 1024.0 && unit_index < 4) {
+        formatted_size /= 1024.0;
+        unit_index++;
+    }
+    return static_cast<size_t>(snprintf(out, kSizeTextCapacity, "%.2f %s", formatted_size, units[unit_index]));
+}
+
+static size_t strftime_iso8601(char* out, int64_t seconds) {
+    const time_t t = static_cast<time_t>(seconds);
+    tm parts;
+#ifdef _WIN32
+    gmtime_s(&parts, &t);
+#else
+    gmtime_r(&t, &parts);
+#endif
+    return strftime(out, kTimeTextCapacity, "%Y-%m-%dT%H:%M:%SZ", &parts);
+}
+
+template <class F>
+static double nanoseconds_per_value(size_t count, F&& f) {
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        f(i);
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / count;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+
+    // 大小在1 B到1 TB之间按数量级均匀分布，时间在1970到2100年之间
+    vector<uintmax_t> sizes(count);
+    vector<int64_t> times(count);
+    uint64_t seed = 88172645463325252ull;
+    auto next = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+    for (size_t i = 0; i < count; i++) {
+        sizes[i] = (next() & ((uint64_t(1) << (next() % 40 + 1)) - 1)) + 1;
+        times[i] = static_cast<int64_t>(next() % 4102444800ull);
+    }
+
+    char buffer[kSizeTextCapacity > kTimeTextCapacity ? kSizeTextCapacity : kTimeTextCapacity];
+    size_t sink = 0;
+    const struct {
+        const char* name;
+        double ns;
+    } results[] = {
+        {"ostringstream (original)", nanoseconds_per_value(count, [&](size_t i) { sink += stream_file_size(sizes[i]).size(); })},
+        {"snprintf", nanoseconds_per_value(count, [&](size_t i) { sink += snprintf_file_size(buffer, sizes[i]); })},
+        {"format_size binary", nanoseconds_per_value(count, [&](size_t i) {
+             sink += static_cast<size_t>(format_size(buffer, sizes[i]) - buffer);
+         })},
+        {"format_size SI", nanoseconds_per_value(count, [&](size_t i) {
+             sink += static_cast<size_t>(format_size(buffer, sizes[i], SizeUnits::SI) - buffer);
+         })},
+        {"format_bytes", nanoseconds_per_value(count, [&](size_t i) {
+             sink += static_cast<size_t>(format_bytes(buffer, sizes[i]) - buffer);
+         })},
+        {"gmtime + strftime", nanoseconds_per_value(count, [&](size_t i) { sink += strftime_iso8601(buffer, times[i]); })},
+        {"format_iso8601", nanoseconds_per_value(count, [&](size_t i) {
+             sink += static_cast<size_t>(format_iso8601(buffer, times[i]) - buffer);
+         })},
+    };
+
+    for (const auto& result : results) {
+        printf("%-26s %7.1f ns/value\n", result.name, result.ns);
+    }
+    printf("(%zu values, checksum %zu)\n", count, sink);
+    return 0;
+}
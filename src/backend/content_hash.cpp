@@ -0,0 +1,255 @@
+#include "content_hash.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint32_t rotr32(uint32_t x, int r) {
+    return (x >> r) | (x << (32 - r));
+}
+
+// 按小端读取（与参考实现一致）
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t xxh_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh_round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+const uint32_t kSha256Round[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+}
+
+Xxh64::Xxh64(uint64_t seed) : seed_(seed) {
+    acc_[0] = seed + kPrime1 + kPrime2;
+    acc_[1] = seed + kPrime2;
+    acc_[2] = seed;
+    acc_[3] = seed - kPrime1;
+}
+
+void Xxh64::update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + length;
+    total_length_ += length;
+
+    // 先补满上次剩下的不足32字节
+    if (buffered_ > 0) {
+        size_t take = min(length, sizeof(buffer_) - buffered_);
+        memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            acc_[i] = xxh_round(acc_[i], read64(buffer_ + i * 8));
+        }
+        buffered_ = 0;
+    }
+
+    // 四路累加器互不依赖，流水线可以并行执行
+    uint64_t a0 = acc_[0], a1 = acc_[1], a2 = acc_[2], a3 = acc_[3];
+    while (end - p >= 32) {
+        a0 = xxh_round(a0, read64(p));
+        a1 = xxh_round(a1, read64(p + 8));
+        a2 = xxh_round(a2, read64(p + 16));
+        a3 = xxh_round(a3, read64(p + 24));
+        p += 32;
+    }
+    acc_[0] = a0;
+    acc_[1] = a1;
+    acc_[2] = a2;
+    acc_[3] = a3;
+
+    buffered_ = static_cast<size_t>(end - p);
+    memcpy(buffer_, p, buffered_);
+}
+
+uint64_t Xxh64::digest() const {
+    uint64_t h;
+    if (total_length_ >= 32) {
+        h = rotl64(acc_[0], 1) + rotl64(acc_[1], 7) + rotl64(acc_[2], 12) + rotl64(acc_[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxh_merge(h, acc_[i]);
+        }
+    } else {
+        h = seed_ + kPrime5;
+    }
+    h += total_length_;
+
+    const unsigned char* p = buffer_;
+    const unsigned char* const end = buffer_ + buffered_;
+    while (end - p >= 8) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl64(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= *p * kPrime5;
+        h = rotl64(h, 11) * kPrime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+Sha256::Sha256() {
+    const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(state_, initial, sizeof(state_));
+}
+
+void Sha256::update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total_length_ += length;
+
+    if (buffered_ > 0) {
+        size_t take = min(length, sizeof(buffer_) - buffered_);
+        memcpy(buffer_ + buffered_, p, take);
+        buffered_ += take;
+        p += take;
+        length -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        transform(buffer_);
+        buffered_ = 0;
+    }
+    while (length >= 64) {
+        transform(p);
+        p += 64;
+        length -= 64;
+    }
+    memcpy(buffer_, p, length);
+    buffered_ = length;
+}
+
+array<uint8_t, 32> Sha256::digest() {
+    // 填充：0x80，若干0，最后8字节为以位计的长度（大端）
+    const uint64_t bit_length = total_length_ * 8;
+    unsigned char padding[72] = {0x80};
+    size_t pad = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; i++) {
+        padding[pad + i] = static_cast<unsigned char>(bit_length >> (56 - 8 * i));
+    }
+    update(padding, pad + 8);
+
+    array<uint8_t, 32> out;
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+        out[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        out[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        out[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+    }
+    return out;
+}
+
+void Sha256::transform(const unsigned char* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + kSha256Round[i] + w[i];
+        uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+
+string to_hex(uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    string out(16, '0');
+    for (int i = 15; i >= 0; i--) {
+        out[i] = digits[value & 0xf];
+        value >>= 4;
+    }
+    return out;
+}
+
+string to_hex(const array<uint8_t, 32>& digest) {
+    static const char digits[] = "0123456789abcdef";
+    string out;
+    out.reserve(64);
+    for (uint8_t byte : digest) {
+        out.push_back(digits[byte >> 4]);
+        out.push_back(digits[byte & 0xf]);
+    }
+    return out;
+}
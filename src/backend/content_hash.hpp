@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 文件内容散列（流式：可多次update）
+
+// XXH64：非加密散列，每周期处理32字节，单线程可达内存带宽，用于查找重复文件的候选
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0);
+
+    void update(const void* data, size_t length);
+    uint64_t digest() const;
+
+private:
+    uint64_t acc_[4];
+    uint64_t seed_;
+    uint64_t total_length_ = 0;
+    unsigned char buffer_[32];
+    size_t buffered_ = 0;
+};
+
+// SHA-256：较慢，用于确认散列相同的文件内容确实相同
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t length);
+    std::array<uint8_t, 32> digest();
+
+private:
+    void transform(const unsigned char* block);
+
+    uint32_t state_[8];
+    uint64_t total_length_ = 0;
+    unsigned char buffer_[64];
+    size_t buffered_ = 0;
+};
+
+// 散列值的十六进制表示
+std::string to_hex(uint64_t value);
+std::string to_hex(const std::array<uint8_t, 32>& digest);
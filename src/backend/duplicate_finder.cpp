@@ -0,0 +1,405 @@
+#include "duplicate_finder.hpp"
+#include "content_hash.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct Candidate {
+    uint32_t index;  // 在ScanResult中的下标（即扫描顺序）
+    uintmax_t size;
+    string path;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t sample = 0;
+    uint64_t full = 0;
+    string sha256;
+    bool whole = false;  // 抽样时已读完整个文件，sample即为全文散列
+    bool failed = false;
+    bool hard_link = false;  // 与前面的候选是同一inode
+};
+
+// 只读打开的文件：定位读取（抽样）和顺序整块读取（全文）
+class InputFile {
+public:
+    explicit InputFile(const string& path) {
+#ifdef _WIN32
+        in_.open(fs::u8path(path), ios::binary);
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    }
+
+    ~InputFile() {
+#ifndef _WIN32
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+#ifdef _WIN32
+    bool is_open() const { return in_.is_open(); }
+#else
+    bool is_open() const { return fd_ >= 0; }
+#endif
+
+    // 当前大小和文件标识（Windows上标识为0，不合并硬链接）
+    bool stat(const string& path, uintmax_t& size, uint64_t& device, uint64_t& inode) {
+#ifdef _WIN32
+        error_code ec;
+        size = fs::file_size(fs::u8path(path), ec);
+        device = inode = 0;
+        return !ec;
+#else
+        (void)path;
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            return false;
+        }
+        size = static_cast<uintmax_t>(st.st_size);
+        device = static_cast<uint64_t>(st.st_dev);
+        inode = static_cast<uint64_t>(st.st_ino);
+        return true;
+#endif
+    }
+
+    // 接下来将顺序读完整个文件
+    void sequential() {
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    // 从offset处读满length字节
+    bool read_at(uintmax_t offset, char* buffer, size_t length) {
+#ifdef _WIN32
+        in_.seekg(static_cast<streamoff>(offset));
+        return static_cast<bool>(in_.read(buffer, static_cast<streamsize>(length)));
+#else
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = ::pread(fd_, buffer + done, length - done, static_cast<off_t>(offset + done));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    // 顺序读取下一块：返回读到的字节数，0为文件末尾，-1为出错
+    long long read(char* buffer, size_t length) {
+#ifdef _WIN32
+        in_.read(buffer, static_cast<streamsize>(length));
+        if (in_.bad()) {
+            return -1;
+        }
+        return static_cast<long long>(in_.gcount());
+#else
+        for (;;) {
+            ssize_t n = ::read(fd_, buffer, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return static_cast<long long>(n);
+        }
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    ifstream in_;
+#else
+    int fd_ = -1;
+#endif
+};
+
+bool is_cancelled(const DuplicateOptions& options) {
+    return options.cancel_token && options.cancel_token->cancelled();
+}
+
+// 各线程从同一个计数器领取下标，每个线程一块读缓冲区
+template <typename Work>
+void run_parallel(WorkStealingPool& pool, size_t count, const Work& work) {
+    atomic<size_t> next{0};
+    for (size_t t = 0; t < pool.size(); t++) {
+        pool.submit([&next, count, &work]() {
+            vector<char> buffer(DuplicateFinder::kReadBlock);
+            for (size_t i; (i = next.fetch_add(1, memory_order_relaxed)) < count;) {
+                work(i, buffer);
+            }
+        });
+    }
+    pool.wait_idle();
+}
+
+// 按块读完整个文件交给hasher；大小与扫描时不同（文件被修改）时失败
+template <typename Hasher>
+bool hash_file(const string& path, uintmax_t size, Hasher& hasher, vector<char>& buffer,
+               const DuplicateOptions& options, atomic<uintmax_t>& bytes_read) {
+    InputFile file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.sequential();
+    uintmax_t total = 0;
+    for (;;) {
+        if (is_cancelled(options)) {
+            return false;
+        }
+        long long n = file.read(buffer.data(), buffer.size());
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        hasher.update(buffer.data(), static_cast<size_t>(n));
+        total += static_cast<uintmax_t>(n);
+    }
+    bytes_read.fetch_add(total, memory_order_relaxed);
+    return total == size;
+}
+
+// 头尾各kSampleBytes；不超过两倍抽样大小的文件整个读取
+bool sample_file(Candidate& candidate, vector<char>& buffer, atomic<uintmax_t>& bytes_read) {
+    constexpr size_t kSample = DuplicateFinder::kSampleBytes;
+    InputFile file(candidate.path);
+    uintmax_t size;
+    if (!file.is_open() || !file.stat(candidate.path, size, candidate.device, candidate.inode) ||
+        size != candidate.size) {
+        return false;
+    }
+
+    Xxh64 hasher;
+    if (size <= 2 * kSample) {
+        if (!file.read_at(0, buffer.data(), static_cast<size_t>(size))) {
+            return false;
+        }
+        hasher.update(buffer.data(), static_cast<size_t>(size));
+        candidate.whole = true;
+        bytes_read.fetch_add(size, memory_order_relaxed);
+    } else {
+        if (!file.read_at(0, buffer.data(), kSample) ||
+            !file.read_at(size - kSample, buffer.data() + kSample, kSample)) {
+            return false;
+        }
+        hasher.update(buffer.data(), 2 * kSample);
+        bytes_read.fetch_add(2 * kSample, memory_order_relaxed);
+    }
+    candidate.sample = hasher.digest();
+    if (candidate.whole) {
+        candidate.full = candidate.sample;
+    }
+    return true;
+}
+
+// 把ids按key分成若干连续的组，只保留至少两个成员的组
+template <typename Key>
+vector<vector<size_t>> group_by(vector<size_t> ids, const vector<Candidate>& candidates, Key key) {
+    sort(ids.begin(), ids.end(), [&](size_t a, size_t b) {
+        auto ka = key(candidates[a]);
+        auto kb = key(candidates[b]);
+        return ka != kb ? ka < kb : candidates[a].index < candidates[b].index;
+    });
+    vector<vector<size_t>> groups;
+    for (size_t begin = 0; begin < ids.size();) {
+        size_t end = begin + 1;
+        while (end < ids.size() && key(candidates[ids[end]]) == key(candidates[ids[begin]])) {
+            end++;
+        }
+        if (end - begin >= 2) {
+            groups.emplace_back(ids.begin() + begin, ids.begin() + end);
+        }
+        begin = end;
+    }
+    return groups;
+}
+
+}
+
+vector<DuplicateGroup> DuplicateFinder::find(const ScanResult& files,
+                                             const DuplicateOptions& options,
+                                             DuplicateStats* stats) {
+    DuplicateStats local_stats;
+    vector<DuplicateGroup> result;
+    using clock = chrono::steady_clock;
+    auto seconds_since = [](clock::time_point start) {
+        return chrono::duration<double>(clock::now() - start).count();
+    };
+
+    // 1. 按大小分组：只有大小相同的文件才可能重复
+    vector<pair<uintmax_t, uint32_t>> by_size;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!files.is_directory(i) && !files.omitted(i) && files.file_size(i) >= options.min_size) {
+            by_size.emplace_back(files.file_size(i), static_cast<uint32_t>(i));
+        }
+    }
+    sort(by_size.begin(), by_size.end());
+
+    vector<Candidate> candidates;
+    for (size_t begin = 0; begin < by_size.size();) {
+        size_t end = begin + 1;
+        while (end < by_size.size() && by_size[end].first == by_size[begin].first) {
+            end++;
+        }
+        if (end - begin >= 2) {
+            for (size_t i = begin; i < end; i++) {
+                Candidate candidate;
+                candidate.index = by_size[i].second;
+                candidate.size = by_size[i].first;
+                candidate.path = files.path(candidate.index);
+                candidates.push_back(std::move(candidate));
+            }
+        }
+        begin = end;
+    }
+    by_size.clear();
+    by_size.shrink_to_fit();
+    local_stats.files_compared = candidates.size();
+
+    WorkStealingPool pool(static_cast<size_t>(max(1, options.threads)));
+    atomic<uintmax_t> bytes_read{0};
+
+    // 2. 头尾抽样（同时取得文件标识）
+    auto start = clock::now();
+    run_parallel(pool, candidates.size(), [&](size_t i, vector<char>& buffer) {
+        candidates[i].failed = is_cancelled(options) || !sample_file(candidates[i], buffer, bytes_read);
+    });
+    local_stats.sample = {candidates.size(), bytes_read.exchange(0), seconds_since(start)};
+
+    vector<size_t> alive;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (!candidates[i].failed) {
+            alive.push_back(i);
+        }
+    }
+
+    // 同一inode的多个路径是同一个文件，只保留扫描顺序中的第一个
+    if (!alive.empty()) {
+        auto identity = [](const Candidate& c) { return make_tuple(c.size, c.device, c.inode); };
+        for (const auto& group : group_by(alive, candidates, identity)) {
+            if (candidates[group[0]].device == 0 && candidates[group[0]].inode == 0) {
+                continue;
+            }
+            for (size_t k = 1; k < group.size(); k++) {
+                candidates[group[k]].hard_link = true;
+                local_stats.hard_links += 1;
+            }
+        }
+        alive.erase(remove_if(alive.begin(), alive.end(), [&](size_t i) { return candidates[i].hard_link; }),
+                    alive.end());
+    }
+
+    // 3. 抽样相同的文件读取全文
+    auto sampled = group_by(alive, candidates, [](const Candidate& c) { return make_pair(c.size, c.sample); });
+    vector<size_t> need_full;
+    for (const auto& group : sampled) {
+        for (size_t i : group) {
+            if (!candidates[i].whole) {
+                need_full.push_back(i);
+            }
+        }
+    }
+    start = clock::now();
+    run_parallel(pool, need_full.size(), [&](size_t k, vector<char>& buffer) {
+        Candidate& candidate = candidates[need_full[k]];
+        Xxh64 hasher;
+        if (!is_cancelled(options) &&
+            hash_file(candidate.path, candidate.size, hasher, buffer, options, bytes_read)) {
+            candidate.full = hasher.digest();
+        } else {
+            candidate.failed = true;
+        }
+    });
+    local_stats.full = {need_full.size(), bytes_read.exchange(0), seconds_since(start)};
+
+    alive.clear();
+    for (const auto& group : sampled) {
+        for (size_t i : group) {
+            if (!candidates[i].failed) {
+                alive.push_back(i);
+            }
+        }
+    }
+    auto full_key = [](const Candidate& c) { return make_pair(c.size, c.full); };
+    vector<vector<size_t>> groups = group_by(alive, candidates, full_key);
+
+    // 4. 可选：SHA-256确认，散列相同而SHA-256不同的文件拆到不同组
+    if (options.verify) {
+        vector<size_t> need_verify;
+        for (const auto& group : groups) {
+            need_verify.insert(need_verify.end(), group.begin(), group.end());
+        }
+        start = clock::now();
+        run_parallel(pool, need_verify.size(), [&](size_t k, vector<char>& buffer) {
+            Candidate& candidate = candidates[need_verify[k]];
+            Sha256 hasher;
+            if (!is_cancelled(options) &&
+                hash_file(candidate.path, candidate.size, hasher, buffer, options, bytes_read)) {
+                candidate.sha256 = to_hex(hasher.digest());
+            } else {
+                candidate.failed = true;
+            }
+        });
+        local_stats.verify = {need_verify.size(), bytes_read.exchange(0), seconds_since(start)};
+
+        need_verify.erase(remove_if(need_verify.begin(), need_verify.end(),
+                                    [&](size_t i) { return candidates[i].failed; }),
+                          need_verify.end());
+        groups = group_by(need_verify, candidates, [](const Candidate& c) {
+            return make_tuple(c.size, c.full, c.sha256);
+        });
+    }
+
+    // 取消后未读取的文件不算读取失败
+    local_stats.cancelled = is_cancelled(options);
+    if (!local_stats.cancelled) {
+        for (const auto& candidate : candidates) {
+            if (candidate.failed) {
+                local_stats.read_errors += 1;
+            }
+        }
+    }
+
+    for (const auto& group : groups) {
+        DuplicateGroup duplicate;
+        const Candidate& first = candidates[group[0]];
+        duplicate.size = first.size;
+        duplicate.hash = options.verify ? first.sha256 : to_hex(first.full);
+        for (size_t i : group) {
+            duplicate.paths.push_back(std::move(candidates[i].path));
+        }
+        local_stats.reclaimable_bytes += duplicate.reclaimable();
+        result.push_back(std::move(duplicate));
+    }
+    stable_sort(result.begin(), result.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        return a.reclaimable() > b.reclaimable();
+    });
+
+    if (stats) {
+        *stats = local_stats;
+    }
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "scan_result.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct DuplicateOptions {
+    int threads = 4;  // 读取文件的线程数
+    uintmax_t min_size = 1;  // 小于此大小的文件不参与比较（默认跳过空文件）
+    bool verify = false;  // 散列相同的文件再用SHA-256确认
+    std::shared_ptr<CancellationToken> cancel_token;  // 可为空
+};
+
+// 内容相同的一组文件
+struct DuplicateGroup {
+    uintmax_t size;  // 每个文件的大小
+    std::string hash;  // 内容散列（十六进制）：verify时为SHA-256，否则为XXH64
+    std::vector<std::string> paths;  // 按扫描顺序，同一文件的其他硬链接不列出
+
+    // 只保留一份时可以释放的字节数
+    uintmax_t reclaimable() const { return size * (paths.size() - 1); }
+};
+
+struct DuplicateStats {
+    uintmax_t files_compared = 0;  // 有同样大小的其他文件、需要读取的文件数
+    uintmax_t hard_links = 0;  // 与同组文件是同一inode而不再比较的路径数
+    uintmax_t read_errors = 0;  // 打开或读取失败（或读取时大小已变化）的文件数
+    uintmax_t reclaimable_bytes = 0;  // 所有组的reclaimable之和
+    bool cancelled = false;
+
+    // 各阶段读取的字节数和耗时
+    struct Stage {
+        uintmax_t files = 0;
+        uintmax_t bytes_read = 0;
+        double seconds = 0;
+
+        double gigabytes_per_second() const { return seconds > 0 ? bytes_read / seconds / 1e9 : 0; }
+    };
+    Stage sample;  // 头尾抽样（小文件在这一阶段整个读取）
+    Stage full;  // 抽样相同的文件全文散列
+    Stage verify;  // SHA-256确认
+};
+
+// 在扫描结果中查找内容相同的文件，逐步缩小候选：
+//   1. 按大小分组，大小唯一的文件不读取
+//   2. 读取头尾各kSampleBytes计算抽样散列，同一inode的硬链接在这里合并
+//   3. 抽样相同的文件读取全文计算XXH64
+//   4. verify时对散列相同的文件再计算SHA-256
+// 每个阶段由线程池并行读取，大文件按kReadBlock顺序整块读取
+class DuplicateFinder {
+public:
+    static constexpr size_t kSampleBytes = 16 * 1024;
+    static constexpr size_t kReadBlock = 1024 * 1024;
+
+    // 按可释放的字节数从多到少排列
+    static std::vector<DuplicateGroup> find(const ScanResult& files,
+                                            const DuplicateOptions& options,
+                                            DuplicateStats* stats = nullptr);
+};
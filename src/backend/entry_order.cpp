@@ -0,0 +1,135 @@
+#include "entry_order.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+inline char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// 前8个字节按大端组成整数，不足8字节补0：整数的大小关系与字节序一致
+uint64_t load_prefix(const char* p, size_t length) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; i++) {
+        prefix <<= 8;
+        if (i < length) {
+            prefix |= static_cast<unsigned char>(p[i]);
+        }
+    }
+    return prefix;
+}
+
+int compare_bytes(const char* a, size_t a_length, const char* b, size_t b_length) {
+    int c = memcmp(a, b, min(a_length, b_length));
+    if (c != 0) {
+        return c;
+    }
+    return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+}
+
+void EntryOrder::reset(SortOrder order) {
+    order_ = order;
+    arena_.clear();
+    keys_.clear();
+}
+
+void EntryOrder::add(string_view name, bool is_directory, uintmax_t size, int64_t mtime) {
+    Key key;
+    key.is_file = !is_directory;
+    key.rank = 0;
+    if (order_ == SortOrder::SizeDesc && !is_directory) {
+        key.rank = ~static_cast<uint64_t>(size);
+    } else if (order_ == SortOrder::MtimeDesc) {
+        // 翻转符号位得到保序的无符号数，再取反
+        key.rank = ~(static_cast<uint64_t>(mtime) ^ (uint64_t(1) << 63));
+    }
+    key.index = static_cast<uint32_t>(keys_.size());
+    
+    key.name_offset = static_cast<uint32_t>(arena_.size());
+    key.name_length = static_cast<uint32_t>(name.size());
+    arena_.append(name.data(), name.size());
+    
+    key.key_offset = key.name_offset;
+    if (order_ == SortOrder::NameNoCase) {
+        key.key_offset = static_cast<uint32_t>(arena_.size());
+        for (char c : name) {
+            arena_.push_back(fold(c));
+        }
+    } else if (order_ == SortOrder::Natural) {
+        key.key_offset = static_cast<uint32_t>(arena_.size());
+        append_natural_key(name);
+    }
+    key.key_length = static_cast<uint32_t>(arena_.size()) - key.key_offset;
+    key.prefix = load_prefix(arena_.data() + key.key_offset, key.key_length);
+    
+    keys_.push_back(key);
+}
+
+void EntryOrder::append_natural_key(string_view name) {
+    // 每段数字写成 '0' + 有效位数 + 去掉前导零的数字：位数少的数值小，位数相同时逐位比较。
+    // 段首的'0'使数字段与其他字符比较时仍处在数字的位置
+    for (size_t i = 0; i < name.size();) {
+        if (!is_digit(name[i])) {
+            arena_.push_back(fold(name[i]));
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while (end < name.size() && is_digit(name[end])) {
+            end++;
+        }
+        while (i + 1 < end && name[i] == '0') {
+            i++;
+        }
+        size_t digits = min<size_t>(end - i, 255);
+        arena_.push_back('0');
+        arena_.push_back(static_cast<char>(digits));
+        arena_.append(name.data() + i, digits);
+        i = end;
+    }
+}
+
+bool EntryOrder::less(const Key& a, const Key& b, const char* arena) {
+    if (a.is_file != b.is_file) {
+        return a.is_file < b.is_file;  // 目录在前
+    }
+    if (a.rank != b.rank) {
+        return a.rank < b.rank;
+    }
+    if (a.prefix != b.prefix) {
+        return a.prefix < b.prefix;
+    }
+    int c = compare_bytes(arena + a.key_offset, a.key_length, arena + b.key_offset, b.key_length);
+    if (c != 0) {
+        return c < 0;
+    }
+    // 名称键相同（大小写不同、数字有前导零）时按原始名称，结果与输入顺序无关
+    c = compare_bytes(arena + a.name_offset, a.name_length, arena + b.name_offset, b.name_length);
+    if (c != 0) {
+        return c < 0;
+    }
+    return a.index < b.index;
+}
+
+const vector<uint32_t>& EntryOrder::sort() {
+    const char* arena = arena_.data();
+    std::sort(keys_.begin(), keys_.end(), [arena](const Key& a, const Key& b) {
+        return less(a, b, arena);
+    });
+    
+    sorted_.clear();
+    sorted_.reserve(keys_.size());
+    for (const auto& key : keys_) {
+        sorted_.push_back(key.index);
+    }
+    return sorted_;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 同一目录下条目的排列顺序（目录总在文件之前）
+enum class SortOrder {
+    Name,  // 名称按字节比较（默认）
+    NameNoCase,  // 名称不区分大小写（ASCII）
+    Natural,  // 名称中的数字按数值比较（file2 < file10），不区分大小写
+    SizeDesc,  // 文件按大小从大到小；目录的大小在扫描其子树之前未知，按名称
+    MtimeDesc,  // 按修改时间从新到旧
+};
+
+// 一个目录内条目的排序：每个条目只计算一次排序键（数值键加上存放在arena中的名称键），
+// 排序时只比较和移动定长的键记录，比较中不构造路径、不分配内存。
+// 各种顺序都化为同样的键比较，速度相同。arena和键数组在reset之间复用，
+// 调用方可以按线程保留一个实例
+class EntryOrder {
+public:
+    // 开始一个新目录，保留已分配的容量
+    void reset(SortOrder order);
+
+    // 排序是否用到大小/修改时间（否则调用方不必在排序前取得）
+    static bool needs_metadata(SortOrder order) {
+        return order == SortOrder::SizeDesc || order == SortOrder::MtimeDesc;
+    }
+
+    // 按调用顺序编号；mtime为file_time_type的计数
+    void add(std::string_view name, bool is_directory, uintmax_t size = 0, int64_t mtime = 0);
+
+    // 排序后的条目编号：目录在前，同类按所选顺序，键相同时按名称字节序
+    const std::vector<uint32_t>& sort();
+
+private:
+    struct Key {
+        bool is_file;
+        uint64_t rank;  // 大小或修改时间，取反后升序即为降序；按名称排序时为0
+        uint64_t prefix;  // 名称键的前8个字节（大端），多数比较在这里就能分出结果
+        uint32_t key_offset;  // 名称键在arena_中的位置
+        uint32_t key_length;
+        uint32_t name_offset;  // 原始名称，名称键相同时比较（按字节序排序时与名称键是同一段）
+        uint32_t name_length;
+        uint32_t index;
+    };
+
+    static bool less(const Key& a, const Key& b, const char* arena);
+    void append_natural_key(std::string_view name);
+
+    SortOrder order_ = SortOrder::Name;
+    std::string arena_;
+    std::vector<Key> keys_;
+    std::vector<uint32_t> sorted_;
+};
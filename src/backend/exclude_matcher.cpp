@@ -0,0 +1,261 @@
+#include "exclude_matcher.hpp"
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+inline char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+string to_lower(string s) {
+    for (auto& c : s) {
+        c = fold(c);
+    }
+    return s;
+}
+
+// lower需已转为小写
+bool iequals(string_view text, string_view lower) {
+    if (text.size() != lower.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); i++) {
+        if (fold(text[i]) != lower[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool has_glob_meta(string_view s) {
+    return s.find_first_of("*?[\\") != string_view::npos;
+}
+
+// 匹配以pattern[p] == '['开头的字符集合。格式错误（没有闭合的]）时返回false，
+// 调用方把'['当作普通字符
+bool match_class(string_view pattern, size_t p, char c, bool& matched, size_t& consumed) {
+    size_t i = p + 1;
+    bool negate = false;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) {
+        negate = true;
+        i++;
+    }
+
+    bool found = false;
+    bool first = true;
+    while (i < pattern.size() && (first || pattern[i] != ']')) {
+        first = false;
+        char lo = pattern[i];
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            char hi = pattern[i + 2];
+            if (lo <= c && c <= hi) {
+                found = true;
+            }
+            i += 3;
+        } else {
+            if (lo == c) {
+                found = true;
+            }
+            i++;
+        }
+    }
+    if (i >= pattern.size()) {
+        return false;
+    }
+
+    matched = (found != negate) && c != '/';
+    consumed = i + 1 - p;
+    return true;
+}
+
+// pattern以"**"开头
+bool match_double_star(string_view pattern, string_view text) {
+    string_view rest = pattern.substr(2);
+
+    if (!rest.empty() && rest[0] == '/') {
+        // "**/"：匹配零个或多个完整的目录层级
+        rest.remove_prefix(1);
+        if (glob_match(rest, text)) {
+            return true;
+        }
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '/' && glob_match(rest, text.substr(i + 1))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (glob_match(rest, text.substr(i))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+bool glob_match(string_view pattern, string_view text) {
+    size_t p = 0;
+    size_t t = 0;
+    size_t star_p = string_view::npos;  // 最近一个单星号之后的模式位置
+    size_t star_t = 0;  // 该星号当前匹配到的文本末尾
+
+    while (t < text.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+
+            if (pc == '*') {
+                if (p + 1 < pattern.size() && pattern[p + 1] == '*') {
+                    if (match_double_star(pattern.substr(p), text.substr(t))) {
+                        return true;
+                    }
+                } else {
+                    star_p = ++p;
+                    star_t = t;
+                    continue;
+                }
+            } else {
+                char c = fold(text[t]);
+                bool matched = false;
+                size_t consumed = 1;
+
+                if (pc == '?') {
+                    matched = c != '/';
+                } else if (pc == '[' && match_class(pattern, p, c, matched, consumed)) {
+                    // 已由match_class处理
+                } else if (pc == '\\' && p + 1 < pattern.size()) {
+                    matched = pattern[p + 1] == c;
+                    consumed = 2;
+                } else {
+                    matched = pc == c;
+                }
+
+                if (matched) {
+                    p += consumed;
+                    t++;
+                    continue;
+                }
+            }
+        }
+
+        // 失配：让上一个单星号多吞一个字符（不能跨越'/'）
+        if (star_p != string_view::npos && text[star_t] != '/') {
+            p = star_p;
+            t = ++star_t;
+            continue;
+        }
+        return false;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+ExcludeMatcher::ExcludeMatcher(const vector<string>& patterns) {
+    for (const auto& pattern : patterns) {
+        if (pattern.empty()) {
+            continue;
+        }
+        rules_.push_back(compile(pattern));
+
+        const Rule& rule = rules_.back();
+        needs_path_ = needs_path_ || rule.kind == Kind::PathGlob;
+        needs_type_ = needs_type_ || rule.directory_only;
+    }
+}
+
+ExcludeMatcher::Rule ExcludeMatcher::compile(string pattern) {
+    Rule rule;
+
+    if (pattern.compare(0, 3, "re:") == 0) {
+        try {
+            rule.kind = Kind::Regex;
+            rule.regex = make_shared<const regex>(pattern.substr(3), regex::icase | regex::optimize);
+            return rule;
+        } catch (const regex_error& e) {
+            cerr << "Warning: Invalid exclude regex \"" << pattern << "\": " << e.what() << endl;
+            pattern = pattern.substr(3);
+        }
+    }
+
+    if (pattern.size() > 1 && pattern.back() == '/') {
+        rule.directory_only = true;
+        pattern.pop_back();
+    }
+
+    bool anchored = false;
+    if (pattern.size() > 1 && pattern.front() == '/') {
+        anchored = true;
+        pattern.erase(0, 1);
+    }
+
+    // dir/** 不必进入目录逐个匹配：直接排除目录本身
+    if (pattern.size() > 3 && pattern.compare(pattern.size() - 3, 3, "/**") == 0) {
+        rule.directory_only = true;
+        pattern.resize(pattern.size() - 3);
+    }
+
+    rule.text = to_lower(std::move(pattern));
+    string_view text = rule.text;
+
+    if (anchored || text.find('/') != string_view::npos) {
+        rule.kind = Kind::PathGlob;
+    } else if (!has_glob_meta(text)) {
+        rule.kind = Kind::Literal;
+    } else if (text.size() > 1 && text.back() == '*' && !has_glob_meta(text.substr(0, text.size() - 1))) {
+        rule.kind = Kind::Prefix;
+        rule.text.pop_back();
+    } else if (text.size() > 1 && text.front() == '*' && !has_glob_meta(text.substr(1))) {
+        rule.kind = Kind::Suffix;
+        rule.text.erase(0, 1);
+    } else {
+        rule.kind = Kind::NameGlob;
+    }
+
+    return rule;
+}
+
+bool ExcludeMatcher::matches(string_view name,
+                             string_view rel_path,
+                             bool is_directory) const {
+    for (const auto& rule : rules_) {
+        if (rule.directory_only && !is_directory) {
+            continue;
+        }
+
+        const string& text = rule.text;
+        bool matched = false;
+        switch (rule.kind) {
+            case Kind::Literal:
+                matched = iequals(name, text);
+                break;
+            case Kind::Prefix:
+                matched = name.size() >= text.size() && iequals(name.substr(0, text.size()), text);
+                break;
+            case Kind::Suffix:
+                matched = name.size() >= text.size() && iequals(name.substr(name.size() - text.size()), text);
+                break;
+            case Kind::NameGlob:
+                matched = glob_match(text, name);
+                break;
+            case Kind::PathGlob:
+                matched = glob_match(text, rel_path);
+                break;
+            case Kind::Regex:
+                matched = regex_match(name.begin(), name.end(), *rule.regex);
+                break;
+        }
+
+        if (matched) {
+            return true;
+        }
+    }
+
+    return false;
+}
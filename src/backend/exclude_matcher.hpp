@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 排除规则匹配器：每次扫描只编译一次FileTreeOptions::exclude_patterns，
+// 之后对每个条目的匹配都不再构造正则、不分配内存（ASCII大小写不敏感）
+//
+// 规则语法（glob）：
+//   node_modules    不含通配符：按名称精确匹配
+//   *.tmp / build*  * 匹配任意字符，? 匹配单个字符，[a-z] / [!a-z] 字符集合
+//   build/          以 / 结尾：只匹配目录
+//   **/test/**      含 / ：按相对扫描根目录的路径匹配，** 可跨越多级目录；
+//                   以 /** 结尾的规则同时排除该目录本身（不再进入）
+//   re:<regex>      按正则表达式匹配名称（兼容旧的正则规则）
+class ExcludeMatcher {
+public:
+    ExcludeMatcher() = default;
+    explicit ExcludeMatcher(const std::vector<std::string>& patterns);
+
+    bool empty() const { return rules_.empty(); }
+
+    // 是否有按相对路径匹配的规则（没有时调用方无需拼接相对路径）
+    bool needs_path() const { return needs_path_; }
+
+    // 是否有只匹配目录的规则（没有时调用方无需为匹配而确定条目类型）
+    bool needs_type() const { return needs_type_; }
+
+    // name: 条目名称；rel_path: 相对扫描根目录的路径（'/'分隔，仅needs_path()时需要）
+    bool matches(std::string_view name,
+                 std::string_view rel_path,
+                 bool is_directory) const;
+
+private:
+    enum class Kind {
+        Literal,  // 名称精确匹配
+        Prefix,  // build*
+        Suffix,  // *.tmp
+        NameGlob,  // 名称通配
+        PathGlob,  // 相对路径通配
+        Regex,  // re:
+    };
+
+    struct Rule {
+        Kind kind;
+        std::string text;  // 已转为小写的字面量或通配模式
+        bool directory_only = false;
+        std::shared_ptr<const std::regex> regex;
+    };
+
+    static Rule compile(std::string pattern);
+
+    std::vector<Rule> rules_;
+    bool needs_path_ = false;
+    bool needs_type_ = false;
+};
+
+// glob匹配（ASCII大小写不敏感，pattern需已转为小写）
+// * 和 ? 不匹配 '/'，** 匹配任意多级路径
+bool glob_match(std::string_view pattern, std::string_view text);
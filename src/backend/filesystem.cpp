@@ -1,11 +1,17 @@
 #include "filesystem.hpp"
+#include "scan_result.hpp"
+#include "tree_text_writer.hpp"
+#include "parallel_scanner.hpp"
+#include "getdents_backend.hpp"
+#include "scan_snapshot.hpp"
+#include "value_format.hpp"
 #include <iostream>
-#include <sstream>
-#include <iomanip>
-#include <regex>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/stat.h>
 #endif
 
 using namespace std;
@@ -30,232 +36,862 @@ static std::string wstring_to_utf8(const std::wstring& wstr) {
 }
 #endif
 
-vector<FileInfo> FileSystemScanner::scan_directory(const string& path, 
-                                                  const FileTreeOptions& options) {
-    vector<FileInfo> result;
+ScanContext::ScanContext(const FileTreeOptions& opts, const string& root)
+    : options(opts), 
+      fd_budget(opts.max_open_dirs), 
+      excludes(opts.exclude_patterns),
+      follow_links(opts.follow_symlinks && !opts.names_only),
+      mounts(opts.mount_policies, opts.one_filesystem, root) {
+    root_prefix = root.size();
+    if (root.empty() || (root.back() != '/' && root.back() != '\\')) {
+        root_prefix += 1;
+    }
+    if (opts.time_limit_ms > 0) {
+        deadline_ = chrono::steady_clock::now() + chrono::milliseconds(opts.time_limit_ms);
+    }
+}
+
+bool ScanContext::should_stop() {
+    if (stop_reason_.load(memory_order_relaxed) != ScanStop::None) {
+        return true;
+    }
+    if (options.cancel_token && options.cancel_token->cancelled()) {
+        stop(ScanStop::Cancelled);
+        return true;
+    }
+    if (options.time_limit_ms > 0 && chrono::steady_clock::now() >= deadline_) {
+        stop(ScanStop::TimeLimit);
+        return true;
+    }
+    return false;
+}
+
+size_t ScanContext::reserve_entries(size_t n) {
+    if (options.max_entries == 0) {
+        return n;
+    }
+    uintmax_t used = entries_.fetch_add(n);
+    if (used + n <= options.max_entries) {
+        return n;
+    }
+    stop(ScanStop::EntryLimit);
+    return used < options.max_entries ? static_cast<size_t>(options.max_entries - used) : 0;
+}
+
+bool InodeSet::insert(uint64_t device, uint64_t inode) {
+    Key key{device, inode};
+    Shard& shard = shards_[KeyHash()(key) % kShards];
+    lock_guard<mutex> lock(shard.mutex);
+    return shard.keys.insert(key).second;
+}
+
+bool ScanContext::enter_directory_once(uint64_t device, uint64_t inode) {
+    if (visited_dirs_.insert(device, inode)) {
+        return true;
+    }
+    cycles_cut_.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void ScanContext::report_links(ScanStats& stats) const {
+    stats.symlinks_followed = symlinks_followed_.load();
+    stats.cycles_cut = cycles_cut_.load();
+}
+
+const MountPolicies::Mount* ScanContext::enter_mount(const fs::path& dir) {
+    if (mounts.empty()) {
+        return nullptr;
+    }
+    const MountPolicies::Mount* mount = mounts.find(dir);
+    if (mount && dir.native().size() <= mount->path.size() + 1) {
+        report_mount(*mount);
+    }
+    return mount;
+}
+
+void ScanContext::report_mount(const MountPolicies::Mount& mount) {
+    lock_guard<mutex> lock(mounts_mutex_);
+    mount_reports_.push_back({mount.path, mount.fstype, mount.action});
+}
+
+void ScanContext::report_mounts(ScanStats& stats) {
+    lock_guard<mutex> lock(mounts_mutex_);
+    stats.mounts = mount_reports_;
+    sort(stats.mounts.begin(), stats.mounts.end(), [](const MountReport& a, const MountReport& b) {
+        return a.path < b.path;
+    });
+}
+
+void ScanContext::stop(ScanStop reason) {
+    // 只记录第一个原因
+    ScanStop expected = ScanStop::None;
+    stop_reason_.compare_exchange_strong(expected, reason);
+}
+
+void FileSystemScanner::scan_directory(const string& path, 
+                                       const FileTreeOptions& options,
+                                       ScanVisitor& visitor,
+                                       ScanStats* stats) {
+    ScanStats local_stats;
+    
+    try {
+        fs::path root_path;
+        if (!resolve_root(path, root_path)) {
+            return;
+        }
+        
+        ScanContext ctx(options, path);
+        enter_root(ctx, root_path);
+        if (options.threads > 1) {
+            local_stats.totals = ParallelScanner::scan(root_path, visitor, ctx, local_stats);
+        } else {
+            local_stats.totals = scan_recursive(root_path, visitor, ctx, local_stats, 0, nullptr, nullptr);
+        }
+        local_stats.stopped = ctx.stop_reason();
+        ctx.report_links(local_stats);
+        ctx.report_mounts(local_stats);
+    } catch (const fs::filesystem_error& e) {
+        cerr << "Filesystem error: " << e.what() << endl;
+    } catch (const exception& e) {
+        cerr << "Error scanning directory: " << e.what() << endl;
+    }
     
+    if (stats) {
+        *stats = local_stats;
+    }
+}
+
+ScanResult FileSystemScanner::scan_directory(const string& path, 
+                                            const FileTreeOptions& options,
+                                            ScanStats* stats) {
+    ScanResult result(path);
+    ScanResultBuilder builder(result);
+    scan_directory(path, options, builder, stats);
+    result.shrink_to_fit();
+    return result;
+}
+
+bool FileSystemScanner::resolve_root(const string& path, fs::path& root_path) {
     if (!is_path_safe(path)) {
         cerr << "Error: Path is not safe to access: " << path << endl;
-        return result;
+        return false;
     }
     
-    try {
 #ifdef _WIN32
-        fs::path root_path = utf8_to_wstring(path);
+    root_path = utf8_to_wstring(path);
 #else
-        fs::path root_path(path);
+    root_path = path;
 #endif
+    
+    if (!fs::exists(root_path)) {
+        cerr << "Error: Path does not exist: " << path << endl;
+        return false;
+    }
+    
+    if (!fs::is_directory(root_path)) {
+        cerr << "Error: Path is not a directory: " << path << endl;
+        return false;
+    }
+    return true;
+}
 
-        if (!fs::exists(root_path)) {
-            cerr << "Error: Path does not exist: " << path << endl;
-            return result;
-        }
+void FileSystemScanner::enter_root(ScanContext& ctx, const fs::path& root_path) {
+    uint64_t device, inode;
+    uintmax_t link_count;
+    if (ctx.follow_links && file_identity(root_path, device, inode, link_count)) {
+        ctx.enter_directory_once(device, inode);
+    }
+}
+
+SubtreeTotals FileSystemScanner::scan_recursive(const fs::path& path, 
+                                               ScanVisitor& visitor, 
+                                               ScanContext& ctx,
+                                               ScanStats& stats,
+                                               int depth,
+                                               const shared_ptr<DirHandle>& parent,
+                                               shared_ptr<DirHandle> opened) {
+    SubtreeTotals totals;
+    
+    try {
+        DirListing listing = list_directory(path, ctx, depth, parent, std::move(opened));
+        stats.pruned.add(listing.pruned);
+        totals.add(listing.pruned);
         
-        if (!fs::is_directory(root_path)) {
-            cerr << "Error: Path is not a directory: " << path << endl;
-            return result;
+        // 目录优先：先进入子目录并递归，离开时带上子树汇总
+        for (auto& subdir : listing.subdirs) {
+            visitor.enter_directory(subdir.info);
+            SubtreeTotals child;
+            if (subdir.descend) {
+                child = scan_recursive(subdir.path, visitor, ctx, stats, depth + 1, 
+                                       listing.handle, std::move(subdir.handle));
+            }
+            visitor.leave_directory(subdir.info, child);
+            child.dir_count += 1;
+            totals.add(child);
         }
         
-        scan_recursive(root_path, result, options, 0);
+        count_omitted_links(ctx, stats, listing);
+        for (const auto& info : listing.files) {
+            count_file(ctx, stats, totals, info);
+            visitor.file(info);
+        }
+    } catch (const fs::filesystem_error& e) {
+        cerr << "Error accessing " << path << ": " << e.what() << endl;
+    }
+    
+    return totals;
+}
+
+// 增量扫描的状态：旧快照中每个目录的子项链表（保持扫描顺序）和正在生成的新快照
+struct FileSystemScanner::RescanState {
+    static constexpr uint32_t kNone = ScanResult::kNoParent;
+    static constexpr uint32_t kNotCached = ScanResult::kNoParent - 1;
+    
+    RescanState(const ScanSnapshot* prev, ScanSnapshot& next_snapshot) 
+        : previous(prev), next(next_snapshot) {
+        if (!previous) {
+            return;
+        }
+        const ScanResult& old = previous->result();
+        first_child.assign(old.size(), kNone);
+        next_sibling.assign(old.size(), kNone);
+        for (size_t i = old.size(); i-- > 0;) {
+            uint32_t& first = old.parent(i) == ScanResult::kNoParent ? root_first : first_child[old.parent(i)];
+            next_sibling[i] = first;
+            first = static_cast<uint32_t>(i);
+        }
+    }
+    
+    uint32_t first(uint32_t dir) const {
+        return dir == ScanResult::kNoParent ? root_first : first_child[dir];
+    }
+    
+    const ScanSnapshot* previous;
+    ScanSnapshot& next;
+    const unordered_set<string>* changed_dirs = nullptr;
+    vector<uint32_t> first_child;
+    vector<uint32_t> next_sibling;
+    uint32_t root_first = kNone;
+};
+
+unique_ptr<ScanSnapshot> FileSystemScanner::rescan_directory(const string& path, 
+                                                             const FileTreeOptions& options,
+                                                             const ScanSnapshot* previous,
+                                                             ScanStats* stats,
+                                                             const unordered_set<string>* changed_dirs) {
+    ScanStats local_stats;
+    auto next = make_unique<ScanSnapshot>(path, options);
+    if (previous && !previous->compatible(path, options)) {
+        previous = nullptr;
+    }
+    
+    try {
+        fs::path root_path;
+        if (resolve_root(path, root_path)) {
+            ScanContext ctx(options, path);
+            RescanState state(previous, *next);
+            state.changed_dirs = changed_dirs;
+            const uint32_t old_root = previous ? ScanResult::kNoParent : RescanState::kNotCached;
+            local_stats.totals = rescan_recursive(root_path, state, ctx, local_stats, 0, 
+                                                  ScanResult::kNoParent, old_root, false, nullptr);
+            local_stats.stopped = ctx.stop_reason();
+            ctx.report_links(local_stats);
+            ctx.report_mounts(local_stats);
+            next->complete_ = local_stats.stopped == ScanStop::None;
+        }
     } catch (const fs::filesystem_error& e) {
         cerr << "Filesystem error: " << e.what() << endl;
     } catch (const exception& e) {
         cerr << "Error scanning directory: " << e.what() << endl;
     }
     
-    return result;
+    next->result_.shrink_to_fit();
+    next->records_.shrink_to_fit();
+    if (stats) {
+        *stats = local_stats;
+    }
+    return next;
 }
 
-void FileSystemScanner::scan_recursive(const fs::path& path, 
-                                      vector<FileInfo>& result, 
-                                      const FileTreeOptions& options,
-                                      int depth) {
-    // 检查深度限制
-    if (options.max_depth >= 0 && depth > options.max_depth) {
-        return;
-    }
+SubtreeTotals FileSystemScanner::rescan_recursive(const fs::path& path, 
+                                                 RescanState& state,
+                                                 ScanContext& ctx,
+                                                 ScanStats& stats,
+                                                 int depth,
+                                                 uint32_t new_dir,
+                                                 uint32_t old_dir,
+                                                 bool refresh_mtime,
+                                                 const shared_ptr<DirHandle>& parent) {
+    SubtreeTotals totals;
+    ScanResult& result = state.next.result_;
     
     try {
-        // 先添加当前目录（如果深度大于0，表示不是根目录）
-        if (depth > 0) {
-            FileInfo dir_info;
+        const ScanSnapshot::DirRecord* record = 
+            old_dir != RescanState::kNotCached ? state.previous->find_record(old_dir) : nullptr;
+        
+        // 先取标识再读取：读取期间发生的变化会在下一次扫描时发现
+        DirStamp stamp;
+        bool have_stamp;
+        bool reuse;
+        if (state.changed_dirs && record && state.changed_dirs->count(path.string()) == 0) {
+            // 实时监视下没有事件的目录：不必stat
+            stamp = record->stamp;
+            have_stamp = true;
+            reuse = true;
+        } else {
+            have_stamp = DirStamp::read(path, stamp);
+            reuse = !state.changed_dirs && record && have_stamp && record->stamp == stamp;
+        }
+        
+        // 根目录和上级复用的目录没有经过后端的登记，在这里登记（上级由后端读取时已登记过）。
+        // 已进入过的按叶子列出，与后端一致
+        const bool registered = !refresh_mtime && new_dir != ScanResult::kNoParent;
+        if (have_stamp && ctx.follow_links && !registered && 
+            !ctx.enter_directory_once(stamp.device, stamp.inode)) {
+            if (refresh_mtime && !ctx.options.names_only) {
+                result.set_last_modified(new_dir, fs::last_write_time(path));
+            }
+            return totals;
+        }
+        if (reuse) {
+            ctx.enter_mount(path);
+        }
+        
+        DirListing listing;
+        vector<uint32_t> old_subdirs;  // listing.subdirs在旧快照中的下标
+        if (reuse) {
+            if (!ctx.should_stop()) {
+                const ScanResult& old = state.previous->result();
+                for (uint32_t c = state.first(old_dir); c != RescanState::kNone; c = state.next_sibling[c]) {
+                    FileInfo info = old.info(c);
+                    if (info.is_directory) {
+                        SubdirEntry subdir{};
 #ifdef _WIN32
-            dir_info.name = wstring_to_utf8(path.filename().wstring());
-            dir_info.path = wstring_to_utf8(path.wstring());
+                        subdir.path = utf8_to_wstring(info.path);
 #else
-            dir_info.name = path.filename().string();
-            dir_info.path = path.string();
+                        subdir.path = info.path;
 #endif
-            dir_info.is_directory = true;
-            dir_info.size = calculate_directory_size(path);
-            dir_info.last_modified = fs::last_write_time(path);
-            dir_info.depth = depth;
+                        subdir.info = std::move(info);
+                        listing.subdirs.push_back(std::move(subdir));
+                        old_subdirs.push_back(c);
+                    } else {
+                        listing.files.push_back(std::move(info));
+                    }
+                }
+                listing.pruned = record->pruned;
+                limit_entries(ctx, listing);
+                stats.dirs_reused += 1;
+            }
+        } else {
+            // 目录条目取自旧快照时，修改时间已过期
+            if (refresh_mtime && !ctx.options.names_only) {
+                result.set_last_modified(new_dir, fs::last_write_time(path));
+            }
+            
+            if (!ctx.should_stop()) {
+                listing = list_directory(path, ctx, depth, parent);
+                stats.dirs_read += 1;
+            }
             
-            result.push_back(dir_info);
+            // 按名称找到子目录在旧快照中的位置。两边的先后取决于sort_order，按大小或修改时间
+            // 排序时与名称无关（子目录的修改时间还可能已经变化），所以把旧的子目录按名称排好再查找
+            old_subdirs.assign(listing.subdirs.size(), RescanState::kNotCached);
+            if (old_dir != RescanState::kNotCached && !listing.subdirs.empty()) {
+                const ScanResult& old = state.previous->result();
+                vector<pair<string_view, uint32_t>> old_by_name;
+                for (uint32_t c = state.first(old_dir); 
+                     c != RescanState::kNone && old.is_directory(c); c = state.next_sibling[c]) {
+                    old_by_name.emplace_back(old.name(c), c);
+                }
+                sort(old_by_name.begin(), old_by_name.end());
+                for (size_t i = 0; i < listing.subdirs.size(); i++) {
+                    const string_view name = listing.subdirs[i].info.name;
+                    auto it = lower_bound(old_by_name.begin(), old_by_name.end(), make_pair(name, uint32_t(0)));
+                    if (it != old_by_name.end() && it->first == name) {
+                        old_subdirs[i] = it->second;
+                    }
+                }
+            }
         }
         
-        // 收集所有条目以便排序
-        vector<fs::directory_entry> entries;
-        for (const auto& entry : fs::directory_iterator(path)) {
-            if (!should_exclude(entry.path(), options.exclude_patterns)) {
-                entries.push_back(entry);
-            }
+        if (have_stamp) {
+            state.next.add_record(new_dir, stamp, listing.pruned);
         }
+        stats.pruned.add(listing.pruned);
+        totals.add(listing.pruned);
         
-        // 排序：目录优先，然后按字母顺序
-        sort(entries.begin(), entries.end(), [](const fs::directory_entry& a, const fs::directory_entry& b) {
-            bool a_is_dir = a.is_directory();
-            bool b_is_dir = b.is_directory();
-            
-            if (a_is_dir != b_is_dir) {
-                return a_is_dir > b_is_dir; // 目录排在前面
+        for (size_t i = 0; i < listing.subdirs.size(); i++) {
+            const auto& subdir = listing.subdirs[i];
+            uint32_t index = result.add(subdir.info, new_dir);
+            SubtreeTotals child;
+            if (subdir.descend) {
+                child = rescan_recursive(subdir.path, state, ctx, stats, depth + 1, 
+                                         index, old_subdirs[i], reuse, listing.handle);
             }
-            
-            return a.path().filename() < b.path().filename();
-        });
+            result.set_totals(index, child);
+            child.dir_count += 1;
+            totals.add(child);
+        }
         
-        // 处理排序后的条目
-        for (const auto& entry : entries) {
-            const auto& entry_path = entry.path();
-            
-            try {
-                if (entry.is_directory()) {
-                    // 递归扫描子目录
-                    scan_recursive(entry_path, result, options, depth + 1);
-                } else {
-                    FileInfo info;
+        count_omitted_links(ctx, stats, listing);
+        for (const auto& info : listing.files) {
+            count_file(ctx, stats, totals, info);
+            result.add(info, new_dir);
+        }
+    } catch (const fs::filesystem_error& e) {
+        cerr << "Error accessing " << path << ": " << e.what() << endl;
+    }
+    
+    return totals;
+}
+
+bool FileSystemScanner::entry_is_directory(const fs::directory_entry& entry, bool follow) {
+    if (!follow) {
+        // 类型已由directory_iterator从目录项缓存（DT_UNKNOWN时才lstat）
+        return !entry.is_symlink() && entry.is_directory();
+    }
+    return entry.is_directory();
+}
+
+bool FileSystemScanner::file_identity(const fs::path& path, uint64_t& device, uint64_t& inode, uintmax_t& link_count) {
 #ifdef _WIN32
-                    info.name = wstring_to_utf8(entry_path.filename().wstring());
-                    info.path = wstring_to_utf8(entry_path.wstring());
+    return false;
 #else
-                    info.name = entry_path.filename().string();
-                    info.path = entry_path.string();
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    device = static_cast<uint64_t>(st.st_dev);
+    inode = static_cast<uint64_t>(st.st_ino);
+    link_count = static_cast<uintmax_t>(st.st_nlink);
+    return true;
 #endif
-                    info.is_directory = false;
-                    info.depth = depth + 1;
-                    info.last_modified = fs::last_write_time(entry_path);
-                    info.size = entry.file_size();
-                    result.push_back(info);
-                }
-            } catch (const fs::filesystem_error& e) {
-                cerr << "Warning: Cannot access " << entry_path << ": " << e.what() << endl;
-                continue;
-            }
+}
+
+fs::file_time_type FileSystemScanner::symlink_write_time(const fs::path& path) {
+#ifdef _WIN32
+    // 没有可移植的方式读取链接本身的时间，取目标的时间（悬空链接为默认值）
+    error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? fs::file_time_type() : time;
+#else
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0) {
+        return fs::file_time_type();
+    }
+#ifdef __APPLE__
+    return from_unix_time(st.st_mtimespec.tv_sec, st.st_mtimespec.tv_nsec);
+#else
+    return from_unix_time(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+#endif
+#endif
+}
+
+// file_time_type的时钟与system_clock纪元不同，差值在各标准库实现中均为整秒
+static chrono::seconds file_clock_offset() {
+    static const auto offset = chrono::round<chrono::seconds>(
+        fs::file_time_type::clock::now().time_since_epoch() - 
+        chrono::duration_cast<fs::file_time_type::duration>(chrono::system_clock::now().time_since_epoch()));
+    return offset;
+}
+
+fs::file_time_type FileSystemScanner::from_unix_time(int64_t seconds, int64_t nanoseconds) {
+    auto since_epoch = chrono::seconds(seconds) + chrono::nanoseconds(nanoseconds);
+    return fs::file_time_type(chrono::duration_cast<fs::file_time_type::duration>(since_epoch + file_clock_offset()));
+}
+
+int64_t FileSystemScanner::to_unix_time(fs::file_time_type time, uint32_t* nanoseconds) {
+    const auto since_epoch = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch() - file_clock_offset());
+    const auto seconds = chrono::floor<chrono::seconds>(since_epoch);
+    if (nanoseconds) {
+        *nanoseconds = static_cast<uint32_t>((since_epoch - seconds).count());
+    }
+    return seconds.count();
+}
+
+FileInfo FileSystemScanner::make_dir_info(const fs::path& path, int depth, bool names_only) {
+    FileInfo dir_info;
+#ifdef _WIN32
+    dir_info.name = wstring_to_utf8(path.filename().wstring());
+    dir_info.path = wstring_to_utf8(path.wstring());
+#else
+    dir_info.name = path.filename().string();
+    dir_info.path = path.string();
+#endif
+    dir_info.is_directory = true;
+    dir_info.size = 0;
+    if (!names_only) {
+        dir_info.last_modified = fs::last_write_time(path);
+    }
+    dir_info.depth = depth;
+    return dir_info;
+}
+
+DirListing FileSystemScanner::list_directory(const fs::path& path, 
+                                             ScanContext& ctx,
+                                             int depth,
+                                             const shared_ptr<DirHandle>& parent,
+                                             shared_ptr<DirHandle> opened) {
+    // 扫描已停止：不再读取，该目录按空目录列出
+    if (ctx.should_stop()) {
+        return DirListing();
+    }
+    
+    // 挂载点规则：跳过的挂载点按空目录列出，只列名称的挂载点不stat，
+    // 限流的挂载点同一时间只有一个线程在读取
+    bool names_only = ctx.options.names_only;
+    unique_lock<mutex> throttle;
+    if (const MountPolicies::Mount* mount = ctx.enter_mount(path)) {
+        if (mount->action == MountAction::Skip) {
+            return DirListing();
+        }
+        names_only = names_only || mount->action == MountAction::NamesOnly;
+        if (mount->throttle) {
+            throttle = unique_lock<mutex>(*mount->throttle);
         }
-    } catch (const fs::filesystem_error& e) {
-        cerr << "Error accessing " << path << ": " << e.what() << endl;
     }
+    
+    auto read_listing = [&]() {
+#ifdef __linux__
+        if (ctx.options.backend == ScanBackend::Getdents || ctx.options.backend == ScanBackend::IoUring) {
+            return GetdentsBackend::list_directory(path, ctx, depth, names_only, parent, std::move(opened));
+        }
+#endif
+        return list_directory_std(path, ctx, depth, names_only);
+    };
+    DirListing listing = read_listing();
+    limit_entries(ctx, listing);
+    return listing;
+}
+
+void FileSystemScanner::count_file(ScanContext& ctx, ScanStats& stats, SubtreeTotals& totals, const FileInfo& info) {
+    if (info.omitted) {
+        totals.size += info.size;
+        totals.file_count += info.file_count;
+        return;
+    }
+    if (info.hard_linked && ctx.is_duplicate_link(info.device, info.inode)) {
+        stats.bytes_deduplicated += info.size;
+    } else {
+        totals.size += info.size;
+    }
+    totals.file_count += 1;
 }
 
-string FileSystemScanner::generate_tree_text(const vector<FileInfo>& files, 
-                                           const FileTreeOptions& options) {
-    ostringstream tree_stream;
+void FileSystemScanner::count_omitted_links(ScanContext& ctx, ScanStats& stats, DirListing& listing) {
+    // 汇总条目可能已被max_entries截掉
+    if (listing.omitted_links.empty() || listing.files.empty() || !listing.files.back().omitted) {
+        return;
+    }
+    FileInfo& summary = listing.files.back();
+    for (const auto& info : listing.omitted_links) {
+        if (ctx.is_duplicate_link(info.device, info.inode)) {
+            stats.bytes_deduplicated += info.size;
+        } else {
+            summary.size += info.size;
+        }
+    }
+    listing.omitted_links.clear();
+}
+
+bool FileSystemScanner::omit_file(ScanContext& ctx, DirListing& listing, const fs::path& dir, FileInfo& info) {
+    // 子目录都列出，剩下的名额给排在前面的文件，之后的文件合为一个汇总条目。
+    // 只超出一个文件时照常列出：汇总条目同样占一行，还丢掉了文件名
+    const size_t max_children = ctx.options.max_children_per_dir;
+    if (max_children == 0) {
+        return false;
+    }
+    auto add = [&listing](FileInfo& summary, FileInfo& file) {
+        summary.file_count += 1;
+        summary.last_modified = max(summary.last_modified, file.last_modified);
+        if (file.hard_linked) {
+            listing.omitted_links.push_back(std::move(file));
+        } else {
+            summary.size += file.size;
+        }
+    };
     
-    if (files.empty()) {
-        return "No files found.";
+    if (listing.files.empty() || !listing.files.back().omitted) {
+        const size_t keep = max_children > listing.subdirs.size() ? max_children - listing.subdirs.size() : 0;
+        if (listing.files.size() <= keep) {
+            return false;
+        }
+        // 第二个超出的文件：与已列出的第一个一起换成汇总条目
+        FileInfo extra = std::move(listing.files.back());
+        listing.files.pop_back();
+        FileInfo summary;
+#ifdef _WIN32
+        summary.path = wstring_to_utf8(dir.wstring());
+#else
+        summary.path = dir.string();
+#endif
+        summary.is_directory = false;
+        summary.size = 0;
+        summary.last_modified = extra.last_modified;
+        summary.depth = extra.depth;
+        summary.omitted = true;
+        add(summary, extra);
+        listing.files.push_back(std::move(summary));
     }
     
-    // 移除错误的根目录显示，因为 files[0] 是第一个子文件而不是根目录
+    add(listing.files.back(), info);
+    return true;
+}
+
+void FileSystemScanner::limit_entries(ScanContext& ctx, DirListing& listing) {
+    // 条目数上限：超出的部分不列出（先保留子目录，与输出顺序一致）
+    const size_t count = listing.subdirs.size() + listing.files.size();
+    const size_t granted = ctx.reserve_entries(count);
+    if (granted < count) {
+        if (granted <= listing.subdirs.size()) {
+            listing.subdirs.resize(granted);
+            listing.files.clear();
+        } else {
+            listing.files.resize(granted - listing.subdirs.size());
+        }
+    }
     
-    // 跟踪每个深度的"是否是最后一个子项"的状态
-    vector<bool> is_last_at_depth(256, false);
+    // 树形文本据此画出└──，不必等下一个条目；复用的条目带有上次的标记，先清除
+    for (auto& subdir : listing.subdirs) {
+        subdir.info.last_in_directory = false;
+    }
+    for (auto& info : listing.files) {
+        info.last_in_directory = false;
+    }
+    if (!listing.files.empty()) {
+        listing.files.back().last_in_directory = true;
+    } else if (!listing.subdirs.empty()) {
+        listing.subdirs.back().info.last_in_directory = true;
+    }
+}
+
+DirListing FileSystemScanner::list_directory_std(const fs::path& path, 
+                                                 ScanContext& ctx,
+                                                 int depth,
+                                                 bool names_only) {
+    const FileTreeOptions& options = ctx.options;
+    DirListing listing;
     
-    for (size_t i = 0; i < files.size(); i++) {
-        const auto& file = files[i];
-        
-        // 如果文件深度为0（理论上scan_recursive没有添加depth=0的项，但以防万一），跳过缩进处理直接显示
-        if (file.depth == 0) {
-            if (file.is_directory) {
-                tree_stream << "📁 " << file.name << endl;
-            } else {
-                tree_stream << "📄 " << file.name << endl;
-            }
-            continue;
+    const bool follow = ctx.follow_links && !names_only;
+    
+    struct Entry {
+        fs::directory_entry entry;
+        bool is_directory;  // 只判断一次，排序时不再查询
+        string name;
+        uintmax_t size = 0;
+        fs::file_time_type last_modified{};
+        bool has_metadata = false;
+    };
+    
+    // 条目的大小和修改时间：不跟随的符号链接取链接本身的时间，不计大小
+    auto read_metadata = [&](Entry& item) {
+        if (names_only || item.has_metadata) {
+            return;
         }
-        
-        // 记录当前项是否是该深度的最后一个
-        bool is_last = true;
-        if (i + 1 < files.size()) {
-            const auto& next_file = files[i + 1];
-            if (next_file.depth > file.depth) {
-                is_last = false;
-            } else if (next_file.depth == file.depth) {
-                is_last = false;
+        const auto& entry_path = item.entry.path();
+        if (!item.is_directory && !follow && item.entry.is_symlink()) {
+            item.last_modified = symlink_write_time(entry_path);
+        } else {
+            item.last_modified = fs::last_write_time(entry_path);
+            if (!item.is_directory) {
+                item.size = item.entry.file_size();
             }
         }
-        is_last_at_depth[file.depth] = is_last;
-        
-        // 绘制树状结构
-        for (int d = 1; d < file.depth; d++) {
-            if (is_last_at_depth[d]) {
-                tree_stream << "    ";
-            } else {
-                tree_stream << "│   ";
-            }
+        item.has_metadata = true;
+    };
+    
+    // 被裁剪的条目：仅在count_pruned时计入汇总
+    auto add_pruned = [&](const Entry& item) {
+        if (!options.count_pruned) {
+            return;
         }
-        
-        // 添加分支符号
-        if (is_last) {
-            tree_stream << "└── ";
+        SubtreeTotals pruned;
+        if (item.is_directory) {
+            pruned = measure_subtree(item.entry.path(), names_only, &ctx);
+            pruned.dir_count += 1;
         } else {
-            tree_stream << "├── ";
+            pruned.file_count = 1;
+            if (!names_only && (follow || !item.entry.is_symlink()) && item.entry.is_regular_file()) {
+                pruned.size = item.entry.file_size();
+            }
         }
-        
-        // 添加图标和文件名
-        if (file.is_directory) {
-            tree_stream << "📁 " << file.name;
-        } else {
-            tree_stream << "📄 " << file.name;
+        pruned.includes_pruned = true;
+        listing.pruned.add(pruned);
+    };
+    
+    // 收集所有条目以便排序：名称只转换一次，按大小/时间排序时先取得元数据
+    const bool needs_metadata = EntryOrder::needs_metadata(options.sort_order);
+    vector<Entry> entries;
+    for (const auto& entry : fs::directory_iterator(path)) {
+        try {
+            Entry item{};
+            item.entry = entry;
+            item.is_directory = entry_is_directory(entry, follow);
+            if (should_exclude(ctx, entry.path(), item.is_directory)) {
+                add_pruned(item);
+                continue;
+            }
+#ifdef _WIN32
+            item.name = wstring_to_utf8(entry.path().filename().wstring());
+#else
+            item.name = entry.path().filename().string();
+#endif
+            if (needs_metadata) {
+                read_metadata(item);
+            }
+            entries.push_back(std::move(item));
+        } catch (const fs::filesystem_error& e) {
+            cerr << "Warning: Cannot access " << entry.path() << ": " << e.what() << endl;
         }
+    }
+    
+    // 排序：目录优先，然后按options.sort_order
+    thread_local EntryOrder order;
+    order.reset(options.sort_order);
+    for (const auto& item : entries) {
+        order.add(item.name, item.is_directory, item.size, item.last_modified.time_since_epoch().count());
+    }
+    
+    // 处理排序后的条目
+    for (uint32_t index : order.sort()) {
+        Entry& item = entries[index];
+        const auto& entry_path = item.entry.path();
         
-        // 添加文件大小（如果启用）
-        if (options.show_size) {
-            tree_stream << " (" << format_file_size(file.size, options.human_readable) << ")";
+        try {
+            if (item.is_directory) {
+                // 检查深度限制：超出的子目录不列出，只统计
+                if (options.max_depth >= 0 && depth + 1 > options.max_depth) {
+                    add_pruned(item);
+                    continue;
+                }
+                // 每个目录只进入一次：链接成环或多个链接指向同一目录时只列出、不再进入（同tree -l）
+                uint64_t device, inode;
+                uintmax_t link_count;
+                const bool descend = !(follow && file_identity(entry_path, device, inode, link_count) && 
+                                       !ctx.enter_directory_once(device, inode));
+                if (descend && follow && item.entry.is_symlink()) {
+                    ctx.count_followed_link();
+                }
+                // 排序时已取得修改时间的不再stat
+                SubdirEntry subdir{};
+                subdir.path = entry_path;
+                subdir.info = make_dir_info(entry_path, depth + 1, names_only || item.has_metadata);
+                if (item.has_metadata) {
+                    subdir.info.last_modified = item.last_modified;
+                }
+                subdir.descend = descend;
+                listing.subdirs.push_back(std::move(subdir));
+            } else {
+                read_metadata(item);
+                FileInfo info;
+                info.is_directory = false;
+                info.depth = depth + 1;
+                info.size = item.size;
+                info.last_modified = item.last_modified;
+                if (!names_only && (follow || !item.entry.is_symlink())) {
+                    uintmax_t link_count;
+                    if (options.count_hardlinks_once && 
+                        file_identity(entry_path, info.device, info.inode, link_count)) {
+                        info.hard_linked = link_count > 1;
+                    }
+                    if (follow && item.entry.is_symlink()) {
+                        ctx.count_followed_link();
+                    }
+                }
+                // 超出max_children_per_dir的文件只计入汇总条目，不生成名称和路径
+                if (omit_file(ctx, listing, path, info)) {
+                    continue;
+                }
+                info.name = std::move(item.name);
+#ifdef _WIN32
+                info.path = wstring_to_utf8(entry_path.wstring());
+#else
+                info.path = entry_path.string();
+#endif
+                listing.files.push_back(std::move(info));
+            }
+        } catch (const fs::filesystem_error& e) {
+            cerr << "Warning: Cannot access " << entry_path << ": " << e.what() << endl;
+            continue;
         }
-        
-        tree_stream << endl;
     }
     
-    return tree_stream.str();
+    return listing;
 }
 
-uintmax_t FileSystemScanner::calculate_directory_size(const fs::path& path) {
-    uintmax_t total_size = 0;
+SubtreeTotals FileSystemScanner::measure_subtree(const fs::path& path, 
+                                                 bool names_only,
+                                                 ScanContext* ctx) {
+    SubtreeTotals totals;
+    
+    // 跳过的挂载点只计目录本身（已由调用方计入）
+    auto skipped_mount = [ctx](const fs::path& dir) {
+        if (!ctx || ctx->mounts.empty()) {
+            return false;
+        }
+        const MountPolicies::Mount* mount = ctx->mounts.find(dir);
+        if (!mount || mount->action != MountAction::Skip) {
+            return false;
+        }
+        ctx->report_mount(*mount);
+        return true;
+    };
+    if (skipped_mount(path)) {
+        return totals;
+    }
     
     try {
-        for (const auto& entry : fs::recursive_directory_iterator(path)) {
-            if (entry.is_regular_file()) {
-                try {
-                    total_size += entry.file_size();
-                } catch (const fs::filesystem_error&) {
-                    // 忽略无法访问的文件
+        auto it = fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied);
+        for (auto end = fs::end(it); it != end; ++it) {
+            const auto& entry = *it;
+            try {
+                if (entry_is_directory(entry, !names_only)) {
+                    if (ctx && ctx->should_stop()) {
+                        break;
+                    }
+                    totals.dir_count += 1;
+                    if (skipped_mount(entry.path())) {
+                        it.disable_recursion_pending();
+                    }
+                } else {
+                    totals.file_count += 1;
+                    if (!names_only && entry.is_regular_file()) {
+                        totals.size += entry.file_size();
+                    }
                 }
+            } catch (const fs::filesystem_error&) {
+                // 忽略无法访问的文件
             }
         }
     } catch (const fs::filesystem_error&) {
         // 忽略无法访问的目录
     }
     
-    return total_size;
+    return totals;
 }
 
-string FileSystemScanner::format_file_size(uintmax_t size, bool human_readable) {
-    if (!human_readable) {
-        return to_string(size) + " B";
-    }
-    
-    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
-    int unit_index = 0;
-    double formatted_size = static_cast<double>(size);
-    
-    while (formatted_size >= 1024.0 && unit_index < 4) {
-        formatted_size /= 1024.0;
-        unit_index++;
-    }
-    
-    ostringstream stream;
-    stream << fixed << setprecision(2) << formatted_size << " " << units[unit_index];
-    return stream.str();
+string FileSystemScanner::generate_tree_text(const ScanResult& files, 
+                                           const FileTreeOptions& options,
+                                           TreeFormat format) {
+    string text;
+    write_tree(files, options, format, TreeWindow(), [&text](string_view chunk) { text.append(chunk); });
+    return text;
+}
+
+uintmax_t FileSystemScanner::calculate_directory_size(const fs::path& path) {
+    return measure_subtree(path).size;
+}
+
+string FileSystemScanner::format_file_size(uintmax_t size, bool human_readable, SizeUnits units, int precision) {
+    string text;
+    append_file_size(text, size, human_readable, units, precision);
+    return text;
+}
+
+void FileSystemScanner::append_file_size(string& out, uintmax_t size, bool human_readable, SizeUnits units, int precision) {
+    char buffer[kSizeTextCapacity];
+    char* end = human_readable ? format_size(buffer, size, units, precision) : format_bytes(buffer, size);
+    out.append(buffer, end);
 }
 
 bool FileSystemScanner::is_path_safe(const fs::path& path) {
@@ -280,53 +916,19 @@ bool FileSystemScanner::is_path_safe(const fs::path& path) {
     }
 }
 
-bool FileSystemScanner::should_exclude(const fs::path& path, 
-                                      const vector<string>& patterns) {
-    string filename;
-#ifdef _WIN32
-    filename = wstring_to_utf8(path.filename().wstring());
-#else
-    filename = path.filename().string();
-#endif
-
-    // 默认排除规则
-    // 默认不排除任何文件，除非用户指定
-    /*
-    // 排除以点开头的隐藏文件/目录（如 .git, .vscode, .DS_Store）
-    if (filename.empty() || filename[0] == '.') {
-        return true;
-    }
-    
-    // 排除常见构建和依赖目录
-    static const vector<string> default_excludes = {
-        "build", "bin", "lib", "node_modules", "vendor", "__pycache__", "target", "dist", "out",
-        "Debug", "Release", "x64", "x86", "obj", "CMakeFiles", "uploads"
-    };
-    
-    for (const auto& exclude : default_excludes) {
-        if (filename == exclude) {
-            return true;
-        }
-    }
-    */
-
-    if (patterns.empty()) {
+bool FileSystemScanner::should_exclude(const ScanContext& ctx, const fs::path& path, bool is_directory) {
+    if (ctx.excludes.empty()) {
         return false;
     }
     
-    for (const auto& pattern : patterns) {
-        try {
-            regex re(pattern, regex::icase);
-            if (regex_match(filename, re)) {
-                return true;
-            }
-        } catch (const regex_error&) {
-            // 无效的正则表达式，尝试简单匹配
-            if (filename.find(pattern) != string::npos) {
-                return true;
-            }
-        }
-    }
-    
-    return false;
-}
\ No newline at end of file
+#ifdef _WIN32
+    string full_path = wstring_to_utf8(path.wstring());
+    replace(full_path.begin(), full_path.end(), '\\', '/');
+#else
+    const string& full_path = path.native();
+#endif
+    string_view full_view = full_path;
+    size_t slash = full_view.rfind('/');
+    string_view name = slash == string_view::npos ? full_view : full_view.substr(slash + 1);
+    return ctx.is_excluded(name, full_view, is_directory);
+}
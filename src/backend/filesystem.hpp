@@ -5,6 +5,15 @@
 #include <filesystem>
 #include <chrono>
 #include <optional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include "exclude_matcher.hpp"
+#include "entry_order.hpp"
+#include "mount_policy.hpp"
+#include "value_format.hpp"
 
 namespace fs = std::filesystem;
 
@@ -15,42 +24,383 @@ struct FileInfo {
     uintmax_t size;  // 文件大小（字节）
     fs::file_time_type last_modified;  // 使用filesystem的时间类型
     int depth;  // 在文件树中的深度
+    uintmax_t file_count = 0;  // 目录：子树中的文件总数
+    uintmax_t dir_count = 0;  // 目录：子树中的子目录总数
+    bool includes_pruned = false;  // size/计数是否包含未列出的（被裁剪的）条目
+    bool last_in_directory = false;  // 所在目录列出的最后一个条目（子目录在前，文件在后）
+    // max_children_per_dir：代替目录中其余未列出文件（至少两个）的汇总条目，名称为空，
+    // file_count为文件数，size为总大小，last_modified为其中最新的修改时间
+    bool omitted = false;
+    // count_hardlinks_once：有多个硬链接的普通文件记下(设备号, inode)，同一inode只计一次大小
+    bool hard_linked = false;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+};
+
+// 目录遍历后端
+enum class ScanBackend {
+    StdFilesystem,  // std::filesystem（可移植，默认）
+    Getdents,  // Linux: getdents64 + fstatat（非Linux平台回退到std::filesystem）
+    IoUring,  // Linux: getdents64 + io_uring批量statx/openat（io_uring不可用时同Getdents）
+};
+
+// 文件树的输出格式（见TreeWriter）
+enum class TreeFormat {
+    Emoji,  // 制表符加图标（默认）
+    Ascii,  // tree --charset=ascii风格，目录名后加"/"
+    Unicode,  // 制表符，不带图标，目录名后加"/"
+    Markdown,  // 嵌套列表
+    Json,  // 与tree -J兼容
+    Ndjson,  // 每行一个JSON对象
+    Csv,  // 带表头的CSV
+};
+
+// 扫描取消标志：可由其他线程（例如取消请求）设置，扫描线程在读取每个目录前检查
+class CancellationToken {
+public:
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+    
+private:
+    std::atomic<bool> cancelled_{false};
 };
 
 struct FileTreeOptions {
     bool show_size = false;  // 是否显示文件大小
     bool human_readable = true;  // 是否使用人类可读的格式（KB, MB等）
+    SizeUnits size_units = SizeUnits::Binary;  // 人类可读大小的进制
+    int size_precision = 2;  // 人类可读大小的小数位数（0-6）
     int max_depth = -1;  // 最大深度，-1表示无限制
-    std::vector<std::string> exclude_patterns;  // 排除模式
+    std::vector<std::string> exclude_patterns;  // 排除模式（glob，见ExcludeMatcher）
+    bool count_pruned = true;  // 是否将被max_depth/排除规则裁剪的子树计入目录总数
+    int threads = 1;  // 扫描线程数，大于1时使用并行扫描
+    ScanBackend backend = ScanBackend::StdFilesystem;  // 目录遍历后端
+    int max_open_dirs = 128;  // getdents后端在遍历期间最多保留打开的目录fd数
+    int io_queue_depth = 64;  // io_uring后端每个线程同时在途的请求数
+    int time_limit_ms = 0;  // 扫描时间上限（毫秒），0表示无限制
+    uintmax_t max_entries = 0;  // 最多列出的条目数，0表示无限制
+    // 每个目录最多列出的条目数，0表示无限制。子目录总是列出，文件按sort_order取前面的
+    // （按大小排序时即最大的），其余文件只计入汇总，合为一个汇总条目（FileInfo::omitted）
+    uint32_t max_children_per_dir = 0;
+    std::shared_ptr<CancellationToken> cancel_token;  // 可为空
+    bool names_only = false;  // 只要名称和类型：类型取自目录项（d_type），不stat，size/last_modified不填充，符号链接不跟随
+    // 跟随符号链接，每个目录只进入一次（并行扫描时多条路径指向同一目录，进入哪条取决于线程调度）；
+    // 为false时链接本身按文件列出，大小为0
+    bool follow_symlinks = false;
+    bool count_hardlinks_once = false;  // 同一inode的多个硬链接只计一次大小（不适用于被裁剪子树的统计）
+    SortOrder sort_order = SortOrder::Name;  // 同一目录下条目的顺序
+    bool one_filesystem = false;  // 不进入根目录下的其他挂载点（find -xdev），挂载点按空目录列出（Linux）
+    std::vector<std::string> mount_policies;  // 挂载点规则，如"nfs4=throttle"（见MountPolicies）
+};
+
+// 子树汇总（自底向上累计）
+struct SubtreeTotals {
+    uintmax_t size = 0;
+    uintmax_t file_count = 0;
+    uintmax_t dir_count = 0;
+    bool includes_pruned = false;  // 是否包含被裁剪的条目
+
+    void add(const SubtreeTotals& other) {
+        size += other.size;
+        file_count += other.file_count;
+        dir_count += other.dir_count;
+        includes_pruned = includes_pruned || other.includes_pruned;
+    }
+
+};
+
+// 扫描提前结束的原因
+enum class ScanStop {
+    None,  // 完整扫描
+    Cancelled,  // cancel_token被取消
+    TimeLimit,  // 超过time_limit_ms
+    EntryLimit,  // 达到max_entries
+};
+
+// 一次扫描的统计信息
+struct ScanStats {
+    SubtreeTotals totals;  // 根目录的汇总（根目录本身不计入dir_count）
+    SubtreeTotals pruned;  // 其中被max_depth/排除规则裁剪、未出现在列表中的部分
+    ScanStop stopped = ScanStop::None;  // 不为None时结果和汇总只包含已扫描的部分
+    uintmax_t dirs_read = 0;  // 增量扫描：重新读取的目录数
+    uintmax_t dirs_reused = 0;  // 增量扫描：复用上次结果的目录数
+    uintmax_t symlinks_followed = 0;  // 跟随的符号链接数（目录项类型为链接的条目）
+    uintmax_t cycles_cut = 0;  // 已进入过而没有再进入的目录数（链接成环，或多个链接指向同一目录）
+    uintmax_t bytes_deduplicated = 0;  // 重复硬链接未计入汇总的字节数
+    std::vector<MountReport> mounts;  // 被跳过、只列名称或限流的挂载点（按路径排序）
+    
+    bool truncated() const { return stopped != ScanStop::None; }
+};
+
+// 打开的目录fd数量上限（防止很深的目录树耗尽fd，EMFILE）
+// 只限制遍历期间为openat子目录而保留的fd；每个扫描线程读取目录时临时占用的一个fd不计入
+class FdBudget {
+public:
+    explicit FdBudget(int limit) : limit_(limit) {}
+    
+    bool try_acquire() {
+        int used = used_.load();
+        while (used < limit_) {
+            if (used_.compare_exchange_weak(used, used + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void release() { used_.fetch_sub(1); }
+    
+private:
+    const int limit_;
+    std::atomic<int> used_{0};
+};
+
+// (设备号, inode)集合：按散列分片加锁，并行扫描的各线程共用
+class InodeSet {
+public:
+    // 第一次加入时返回true
+    bool insert(uint64_t device, uint64_t inode);
+    
+private:
+    struct Key {
+        uint64_t device;
+        uint64_t inode;
+        bool operator==(const Key& other) const { return device == other.device && inode == other.inode; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return static_cast<size_t>((key.inode * 0x9E3779B97F4A7C15ULL) ^ key.device);
+        }
+    };
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_set<Key, KeyHash> keys;
+    };
+    static constexpr size_t kShards = 64;
+    
+    Shard shards_[kShards];
+};
+
+// 后端相关的已打开目录（getdents后端使用）
+class DirHandle;
+
+// 紧凑的扫描结果（见scan_result.hpp）
+class ScanResult;
+
+// 扫描事件接收者（见scan_visitor.hpp）
+class ScanVisitor;
+
+// 供增量扫描复用的扫描快照（见scan_snapshot.hpp）
+class ScanSnapshot;
+
+// 单次扫描的共享状态（所有扫描线程共用）
+struct ScanContext {
+    // root: 扫描根目录（UTF-8，'/'分隔），用于计算排除规则所需的相对路径
+    ScanContext(const FileTreeOptions& opts, const std::string& root);
+    
+    // 条目是否被排除。full_path只在有按路径匹配的规则时使用
+    bool is_excluded(std::string_view name, std::string_view full_path, bool is_directory) const {
+        if (excludes.empty()) {
+            return false;
+        }
+        std::string_view rel_path;
+        if (excludes.needs_path()) {
+            rel_path = full_path.size() > root_prefix ? full_path.substr(root_prefix) : name;
+        }
+        return excludes.matches(name, rel_path, is_directory);
+    }
+    
+    // 是否应停止扫描（取消或超时）；一旦返回true，之后始终返回true
+    bool should_stop();
+    
+    // 为一个目录的n个条目申请名额，返回可以列出的数量（达到max_entries后少于n）
+    size_t reserve_entries(size_t n);
+    
+    ScanStop stop_reason() const { return stop_reason_.load(); }
+    
+    // follow_symlinks：登记将要进入的目录，已进入过时返回false（计入cycles_cut）
+    bool enter_directory_once(uint64_t device, uint64_t inode);
+    
+    // count_hardlinks_once：该inode是否已经计入过
+    bool is_duplicate_link(uint64_t device, uint64_t inode) { return !counted_files_.insert(device, inode); }
+    
+    // 跟随了一个符号链接
+    void count_followed_link() { symlinks_followed_.fetch_add(1, std::memory_order_relaxed); }
+    
+    // 把跟随的链接数和未再进入的目录数写入stats
+    void report_links(ScanStats& stats) const;
+    
+    // 将要读取（或复用）的目录所在的有规则的挂载点，正常扫描时返回nullptr。
+    // dir是挂载点本身时记录下来，扫描结束后由report_mounts写入stats
+    const MountPolicies::Mount* enter_mount(const fs::path& dir);
+    void report_mount(const MountPolicies::Mount& mount);
+    void report_mounts(ScanStats& stats);
+    
+    const FileTreeOptions& options;
+    FdBudget fd_budget;
+    ExcludeMatcher excludes;  // 每次扫描只编译一次
+    size_t root_prefix;  // 根目录路径加分隔符的长度
+    const bool follow_links;  // 跟随符号链接：follow_symlinks且非names_only
+    const MountPolicies mounts;  // 扫描开始时读取挂载表
+    
+private:
+    void stop(ScanStop reason);
+    
+    std::chrono::steady_clock::time_point deadline_;  // time_limit_ms为0时不使用
+    std::atomic<uintmax_t> entries_{0};
+    std::atomic<ScanStop> stop_reason_{ScanStop::None};
+    InodeSet visited_dirs_;
+    InodeSet counted_files_;
+    std::atomic<uintmax_t> symlinks_followed_{0};
+    std::atomic<uintmax_t> cycles_cut_{0};
+    std::mutex mounts_mutex_;
+    std::vector<MountReport> mount_reports_;
+};
+
+// 待递归的子目录
+struct SubdirEntry {
+    fs::path path;
+    FileInfo info;  // 目录条目（大小稍后由子项回填）
+    std::shared_ptr<DirHandle> handle;  // 已预先打开的该目录（io_uring后端，可能为空）
+    bool descend = true;  // 已进入过的目录（链接成环或多个链接指向同一目录）为false，只列出不进入
+};
+
+// 单个目录的读取结果（已过滤、已排序）
+struct DirListing {
+    std::vector<SubdirEntry> subdirs;  // 子目录（descend为true的需要继续递归）
+    std::vector<FileInfo> files;  // 文件条目
+    SubtreeTotals pruned;  // 本目录中被裁剪掉的条目
+    std::vector<FileInfo> omitted_links;  // 未列出的文件中有多个硬链接的，发出条目时才去重计入汇总条目
+    std::shared_ptr<DirHandle> handle;  // 仍保持打开、供子目录openat使用的目录（可能为空）
 };
 
 class FileSystemScanner {
+    friend class ParallelScanner;
+    friend class GetdentsBackend;
+    
 public:
+    // 扫描目录，边遍历边把条目交给visitor（流式）
+    static void scan_directory(const std::string& path, 
+                               const FileTreeOptions& options,
+                               ScanVisitor& visitor,
+                               ScanStats* stats = nullptr);
+    
     // 扫描目录并返回文件树
-    static std::vector<FileInfo> scan_directory(const std::string& path, 
-                                               const FileTreeOptions& options = {});
+    static ScanResult scan_directory(const std::string& path, 
+                                     const FileTreeOptions& options = {},
+                                     ScanStats* stats = nullptr);
+    
+    // 增量扫描：与previous（同一根目录上一次的快照，可为空）比较每个目录的标识，
+    // 未变化的目录直接复用上次的子项，只重新读取变化的目录。总是串行扫描
+    // changed_dirs: 给出时不比较标识，只重新读取其中的目录（完整路径，来自实时监视）
+    static std::unique_ptr<ScanSnapshot> rescan_directory(const std::string& path, 
+                                                          const FileTreeOptions& options,
+                                                          const ScanSnapshot* previous,
+                                                          ScanStats* stats = nullptr,
+                                                          const std::unordered_set<std::string>* changed_dirs = nullptr);
     
-    // 生成制表符格式的文件树字符串
-    static std::string generate_tree_text(const std::vector<FileInfo>& files, 
-                                         const FileTreeOptions& options = {});
+    // 按format生成文件树字符串（默认为制表符格式）
+    static std::string generate_tree_text(const ScanResult& files, 
+                                         const FileTreeOptions& options = {},
+                                         TreeFormat format = TreeFormat::Emoji);
     
     // 计算目录总大小
     static uintmax_t calculate_directory_size(const fs::path& path);
     
-    // 格式化文件大小为人类可读的字符串
-    static std::string format_file_size(uintmax_t size, bool human_readable = true);
+    // 格式化文件大小为人类可读的字符串（human_readable为false时为"1536 B"）
+    static std::string format_file_size(uintmax_t size, bool human_readable = true,
+                                        SizeUnits units = SizeUnits::Binary, int precision = 2);
+    
+    // 同format_file_size，直接追加到out（见value_format.hpp）
+    static void append_file_size(std::string& out, uintmax_t size, bool human_readable = true,
+                                 SizeUnits units = SizeUnits::Binary, int precision = 2);
+    
+    // file_time_type转换为Unix时间（秒，向下取整），nanoseconds不为空时给出不足一秒的部分
+    static int64_t to_unix_time(fs::file_time_type time, uint32_t* nanoseconds = nullptr);
     
     // 验证路径是否安全可访问
     static bool is_path_safe(const fs::path& path);
     
 private:
-    // 递归扫描目录
-    static void scan_recursive(const fs::path& path, 
-                              std::vector<FileInfo>& result, 
-                              const FileTreeOptions& options,
-                              int depth = 0);
-    
-    // 检查文件是否应该被排除
-    static bool should_exclude(const fs::path& path, 
-                              const std::vector<std::string>& patterns);
+    // 检查扫描根目录（安全、存在、是目录），失败时输出错误并返回false
+    static bool resolve_root(const std::string& path, fs::path& root_path);
+    
+    // 跟随符号链接时登记根目录，指回根目录的链接不再进入
+    static void enter_root(ScanContext& ctx, const fs::path& root_path);
+    
+    // 递归扫描目录，返回该目录子树的汇总（单次遍历自底向上累计）
+    static SubtreeTotals scan_recursive(const fs::path& path, 
+                                       ScanVisitor& visitor, 
+                                       ScanContext& ctx,
+                                       ScanStats& stats,
+                                       int depth,
+                                       const std::shared_ptr<DirHandle>& parent,
+                                       std::shared_ptr<DirHandle> opened);
+    
+    struct RescanState;
+    
+    // 增量扫描一个目录。new_dir/old_dir为该目录在新/旧快照中的下标（根目录为kNoParent，
+    // 旧快照中没有时old_dir为kNotCached）；refresh_mtime表示目录条目取自旧快照，需要更新修改时间
+    static SubtreeTotals rescan_recursive(const fs::path& path, 
+                                         RescanState& state,
+                                         ScanContext& ctx,
+                                         ScanStats& stats,
+                                         int depth,
+                                         uint32_t new_dir,
+                                         uint32_t old_dir,
+                                         bool refresh_mtime,
+                                         const std::shared_ptr<DirHandle>& parent);
+    
+    // 把文件计入目录汇总：count_hardlinks_once时已计入过的inode不计大小。
+    // 在按输出顺序发出条目时调用（并行扫描也是单线程），结果与线程数无关
+    static void count_file(ScanContext& ctx, ScanStats& stats, SubtreeTotals& totals, const FileInfo& info);
+    
+    // max_children_per_dir：名额已满时把文件（尚无名称和路径）计入listing末尾的汇总条目并返回true，
+    // 否则返回false，由调用方列出。超出的第一个文件照常列出，有第二个时才与它一起合为汇总条目。
+    // 后端按排序后的顺序在读取时调用，子目录须已全部加入listing
+    static bool omit_file(ScanContext& ctx, DirListing& listing, const fs::path& dir, FileInfo& info);
+    
+    // 按max_entries截断一个目录的读取结果，并标出截断后的最后一个条目
+    static void limit_entries(ScanContext& ctx, DirListing& listing);
+    
+    // 把listing.omitted_links按输出顺序去重后计入汇总条目（files的最后一个），在count_file之前调用
+    static void count_omitted_links(ScanContext& ctx, ScanStats& stats, DirListing& listing);
+    
+    // 读取单个目录：过滤、排序，并统计被裁剪的条目（按ctx.options.backend分派）
+    // opened: 已预先打开的本目录（可能为空）
+    static DirListing list_directory(const fs::path& path, 
+                                     ScanContext& ctx,
+                                     int depth,
+                                     const std::shared_ptr<DirHandle>& parent,
+                                     std::shared_ptr<DirHandle> opened = nullptr);
+    
+    // std::filesystem后端。names_only: 本目录是否只列名称（选项或挂载点规则）
+    static DirListing list_directory_std(const fs::path& path, 
+                                         ScanContext& ctx,
+                                         int depth,
+                                         bool names_only);
+    
+    // 条目是否为目录。follow为false时只用目录项缓存的类型，不跟随符号链接
+    static bool entry_is_directory(const fs::directory_entry& entry, bool follow);
+    
+    // 路径（跟随符号链接）的设备号、inode和链接数。Windows上没有inode，返回false
+    static bool file_identity(const fs::path& path, uint64_t& device, uint64_t& inode, uintmax_t& link_count);
+    
+    // 符号链接本身的修改时间（不跟随）
+    static fs::file_time_type symlink_write_time(const fs::path& path);
+    
+    // Unix时间（秒+纳秒）转换为file_time_type
+    static fs::file_time_type from_unix_time(int64_t seconds, int64_t nanoseconds);
+    
+    // 生成目录条目（大小稍后由子项回填；names_only时不读取修改时间）
+    static FileInfo make_dir_info(const fs::path& path, int depth, bool names_only);
+    
+    // 统计被裁剪子树的大小与数量（不生成FileInfo；names_only时只计数）
+    // 给出ctx时，扫描停止后不再继续统计
+    static SubtreeTotals measure_subtree(const fs::path& path, 
+                                         bool names_only = false,
+                                         ScanContext* ctx = nullptr);
+    
+    // 检查条目是否应该被排除
+    static bool should_exclude(const ScanContext& ctx, const fs::path& path, bool is_directory);
 };
\ No newline at end of file
@@ -0,0 +1,453 @@
+#include "getdents_backend.hpp"
+#include "io_uring_queue.hpp"
+
+#ifdef __linux__
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace {
+
+// getdents64返回的原始目录项布局
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// 每个扫描线程复用一块读取缓冲区
+constexpr size_t kDirentBufferSize = 256 * 1024;
+
+string join_path(const string& dir, const string& name) {
+    string full;
+    full.reserve(dir.size() + 1 + name.size());
+    full = dir;
+    if (full.empty() || full.back() != '/') {
+        full += '/';
+    }
+    full += name;
+    return full;
+}
+
+fs::filesystem_error make_error(const char* what, const string& path, int err) {
+    return fs::filesystem_error(what, fs::path(path), error_code(err, generic_category()));
+}
+
+}  // namespace
+
+DirHandle::~DirHandle() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (budget_) {
+        budget_->release();
+    }
+}
+
+shared_ptr<DirHandle> GetdentsBackend::open_directory(const string& path, 
+                                                      const string& name,
+                                                      const DirHandle* parent) {
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd = (parent && !name.empty()) 
+        ? ::openat(parent->fd(), name.c_str(), flags) 
+        : ::open(path.c_str(), flags);
+    if (fd < 0) {
+        throw make_error("cannot open directory", path, errno);
+    }
+    return make_shared<DirHandle>(fd);
+}
+
+void GetdentsBackend::read_entries(int fd, const string& path, vector<RawEntry>& entries) {
+    thread_local vector<char> buffer(kDirentBufferSize);
+    
+    while (true) {
+        long bytes = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw make_error("cannot read directory", path, errno);
+        }
+        if (bytes == 0) {
+            break;
+        }
+        
+        for (long offset = 0; offset < bytes;) {
+            const auto* dirent = reinterpret_cast<const linux_dirent64*>(buffer.data() + offset);
+            offset += dirent->d_reclen;
+            
+            const char* name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            entries.push_back({name, dirent->d_type});
+        }
+    }
+}
+
+fs::file_time_type GetdentsBackend::to_file_time(const struct timespec& ts) {
+    return FileSystemScanner::from_unix_time(ts.tv_sec, ts.tv_nsec);
+}
+
+DirListing GetdentsBackend::list_directory(const fs::path& path, 
+                                           ScanContext& ctx,
+                                           int depth,
+                                           bool names_only,
+                                           const shared_ptr<DirHandle>& parent,
+                                           shared_ptr<DirHandle> opened) {
+    const FileTreeOptions& options = ctx.options;
+    const string& dir_path = path.native();
+    DirListing listing;
+    
+    shared_ptr<DirHandle> handle = opened 
+        ? std::move(opened) 
+        : open_directory(dir_path, parent ? path.filename().native() : string(), parent.get());
+    vector<RawEntry> entries;
+    read_entries(handle->fd(), dir_path, entries);
+    
+    struct Candidate {
+        RawEntry* entry;
+        struct stat st;
+        bool is_directory;
+    };
+    vector<Candidate> kept;
+    kept.reserve(entries.size());
+    
+    const bool follow = ctx.follow_links && !names_only;
+    
+    // io_uring后端：先一次提交所有条目的stat，下面直接取结果
+    vector<struct stat> prefetched;
+    vector<int> prefetch_errors;
+    const bool have_prefetched = !names_only && prefetch_stats(ctx, handle->fd(), follow, entries, 
+                                                                 prefetched, prefetch_errors);
+    
+    // 被裁剪的条目：仅在count_pruned时计入汇总。st为空表示未stat（names_only）
+    auto add_pruned = [&](const RawEntry& entry, bool is_directory, const struct stat* st) {
+        SubtreeTotals pruned;
+        if (is_directory) {
+            measure_subtree(join_path(dir_path, entry.name), entry.name, handle.get(), ctx, names_only, pruned);
+            pruned.dir_count += 1;
+        } else {
+            pruned.file_count = 1;
+            if (st && S_ISREG(st->st_mode)) {
+                pruned.size = static_cast<uintmax_t>(st->st_size);
+            }
+        }
+        pruned.includes_pruned = true;
+        listing.pruned.add(pruned);
+    };
+    
+    const bool needs_path = ctx.excludes.needs_path();
+    for (size_t i = 0; i < entries.size(); i++) {
+        RawEntry& entry = entries[i];
+        struct stat st;
+        bool have_stat = false;
+        bool is_directory = entry.type == DT_DIR;
+        
+        if (names_only) {
+            // 只在文件系统不提供d_type时lstat；符号链接不跟随，按文件列出
+            if (entry.type == DT_UNKNOWN) {
+                if (::fstatat(handle->fd(), entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    cerr << "Warning: Cannot access \"" << join_path(dir_path, entry.name) << "\": " 
+                         << strerror(errno) << endl;
+                    continue;
+                }
+                is_directory = S_ISDIR(st.st_mode);
+            }
+        }
+        
+        // 与std::filesystem后端一致：follow_symlinks时跟随符号链接
+        auto do_stat = [&]() {
+            if (have_prefetched) {
+                st = prefetched[i];
+                errno = prefetch_errors[i];
+                have_stat = prefetch_errors[i] == 0;
+            } else {
+                have_stat = ::fstatat(handle->fd(), entry.name.c_str(), &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+            }
+            return have_stat;
+        };
+        
+        bool excluded = false;
+        if (!ctx.excludes.empty()) {
+            // 目录规则需要条目类型：d_type无法确定（未知或符号链接）时先stat
+            if (!names_only && ctx.excludes.needs_type() && 
+                (entry.type == DT_UNKNOWN || entry.type == DT_LNK) && do_stat()) {
+                is_directory = S_ISDIR(st.st_mode);
+            }
+            excluded = ctx.is_excluded(entry.name, 
+                                       needs_path ? join_path(dir_path, entry.name) : string(), 
+                                       is_directory);
+            if (excluded && !options.count_pruned) {
+                continue;
+            }
+        }
+        
+        if (!names_only) {
+            if (!have_stat && !do_stat()) {
+                if (!excluded) {
+                    cerr << "Warning: Cannot access \"" << join_path(dir_path, entry.name) << "\": " 
+                         << strerror(errno) << endl;
+                }
+                continue;
+            }
+            is_directory = S_ISDIR(st.st_mode);
+        }
+        
+        if (excluded || (is_directory && options.max_depth >= 0 && depth + 1 > options.max_depth)) {
+            if (options.count_pruned) {
+                add_pruned(entry, is_directory, names_only ? nullptr : &st);
+            }
+            continue;
+        }
+        
+        // 不跟随的符号链接按文件列出（lstat的结果）
+        if (!names_only && !is_directory && !S_ISREG(st.st_mode) && !S_ISLNK(st.st_mode)) {
+            cerr << "Warning: Cannot access \"" << join_path(dir_path, entry.name) << "\": not a regular file" << endl;
+            continue;
+        }
+        
+        kept.push_back({&entry, st, is_directory});
+    }
+    
+    // 排序：目录优先，然后按options.sort_order（stat的结果已在手，按大小/时间排序不需额外调用）
+    thread_local EntryOrder order;
+    order.reset(options.sort_order);
+    for (const auto& candidate : kept) {
+        uintmax_t size = 0;
+        int64_t mtime = 0;
+        if (!names_only) {
+            size = S_ISREG(candidate.st.st_mode) ? static_cast<uintmax_t>(candidate.st.st_size) : 0;
+            mtime = to_file_time(candidate.st.st_mtim).time_since_epoch().count();
+        }
+        order.add(candidate.entry->name, candidate.is_directory, size, mtime);
+    }
+    
+    for (uint32_t index : order.sort()) {
+        Candidate& candidate = kept[index];
+        // 每个目录只进入一次：链接成环或多个链接指向同一目录时只列出、不再进入
+        // （按排序后的顺序，与std后端一致）
+        bool descend = true;
+        if (follow) {
+            if (candidate.is_directory && !ctx.enter_directory_once(candidate.st.st_dev, candidate.st.st_ino)) {
+                descend = false;
+            } else if (candidate.entry->type == DT_LNK) {
+                ctx.count_followed_link();
+            }
+        }
+        
+        FileInfo info;
+        info.is_directory = candidate.is_directory;
+        info.depth = depth + 1;
+        info.size = 0;
+        if (!names_only) {
+            info.last_modified = to_file_time(candidate.st.st_mtim);
+        }
+        
+        if (candidate.is_directory) {
+            info.path = join_path(dir_path, candidate.entry->name);
+            info.name = std::move(candidate.entry->name);
+            SubdirEntry subdir{};
+            subdir.path = info.path;
+            subdir.info = std::move(info);
+            subdir.descend = descend;
+            listing.subdirs.push_back(std::move(subdir));
+        } else {
+            if (!names_only && S_ISREG(candidate.st.st_mode)) {
+                info.size = static_cast<uintmax_t>(candidate.st.st_size);
+                if (options.count_hardlinks_once && candidate.st.st_nlink > 1) {
+                    info.hard_linked = true;
+                    info.device = static_cast<uint64_t>(candidate.st.st_dev);
+                    info.inode = static_cast<uint64_t>(candidate.st.st_ino);
+                }
+            }
+            // 超出max_children_per_dir的文件只计入汇总条目，不生成名称和路径
+            if (FileSystemScanner::omit_file(ctx, listing, path, info)) {
+                continue;
+            }
+            info.path = join_path(dir_path, candidate.entry->name);
+            info.name = std::move(candidate.entry->name);
+            listing.files.push_back(std::move(info));
+        }
+    }
+    
+    // 有子目录时尽量保持打开以便openat，超出上限则关闭，子目录改用完整路径打开
+    // （预先打开的目录已经占用了名额）
+    if (!listing.subdirs.empty() && (handle->retained() || ctx.fd_budget.try_acquire())) {
+        handle->retain(&ctx.fd_budget);
+        prefetch_subdirs(ctx, handle->fd(), listing.subdirs);
+        listing.handle = std::move(handle);
+    }
+    
+    return listing;
+}
+
+bool GetdentsBackend::prefetch_stats(const ScanContext& ctx,
+                                     int dirfd,
+                                     bool follow,
+                                     const vector<RawEntry>& entries,
+                                     vector<struct stat>& results,
+                                     vector<int>& errors) {
+#ifdef HAVE_IO_URING
+    if (ctx.options.backend != ScanBackend::IoUring || entries.empty()) {
+        return false;
+    }
+    IoUringQueue* queue = IoUringQueue::for_current_thread(static_cast<unsigned>(max(ctx.options.io_queue_depth, 1)));
+    if (!queue) {
+        return false;
+    }
+    
+    vector<const char*> names;
+    names.reserve(entries.size());
+    for (const auto& entry : entries) {
+        names.push_back(entry.name.c_str());
+    }
+    queue->stat_batch(dirfd, names, results, errors, follow);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void GetdentsBackend::prefetch_subdirs(ScanContext& ctx, int dirfd, vector<SubdirEntry>& subdirs) {
+#ifdef HAVE_IO_URING
+    if (ctx.options.backend != ScanBackend::IoUring) {
+        return;
+    }
+    IoUringQueue* queue = IoUringQueue::for_current_thread(static_cast<unsigned>(max(ctx.options.io_queue_depth, 1)));
+    if (!queue) {
+        return;
+    }
+    
+    // 每个预先打开的目录占用一个fd名额，最多一个队列深度，其余子目录稍后自行打开
+    vector<const char*> names;
+    vector<size_t> targets;
+    const size_t limit = min(subdirs.size(), static_cast<size_t>(max(ctx.options.io_queue_depth, 1)));
+    for (size_t i = 0; i < limit; i++) {
+        if (!subdirs[i].descend) {
+            continue;
+        }
+        if (!ctx.fd_budget.try_acquire()) {
+            break;
+        }
+        names.push_back(subdirs[i].info.name.c_str());
+        targets.push_back(i);
+    }
+    if (names.empty()) {
+        return;
+    }
+    
+    vector<int> fds;
+    queue->open_directory_batch(dirfd, names, fds);
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (fds[i] < 0) {
+            // 打开失败：子目录扫描时再同步打开并报告错误
+            ctx.fd_budget.release();
+            continue;
+        }
+        auto handle = make_shared<DirHandle>(fds[i]);
+        handle->retain(&ctx.fd_budget);
+        subdirs[targets[i]].handle = std::move(handle);
+    }
+#endif
+}
+
+void GetdentsBackend::measure_subtree(const string& path, 
+                                      const string& name,
+                                      const DirHandle* parent,
+                                      ScanContext& ctx,
+                                      bool names_only,
+                                      SubtreeTotals& totals) {
+    if (ctx.should_stop()) {
+        return;
+    }
+    // 跳过的挂载点只计目录本身（已由上级计入）
+    if (!ctx.mounts.empty()) {
+        const MountPolicies::Mount* mount = ctx.mounts.find(path);
+        if (mount && mount->action == MountAction::Skip) {
+            ctx.report_mount(*mount);
+            return;
+        }
+    }
+    
+    shared_ptr<DirHandle> handle;
+    vector<RawEntry> entries;
+    try {
+        handle = open_directory(path, name, parent);
+        read_entries(handle->fd(), path, entries);
+    } catch (const fs::filesystem_error&) {
+        // 忽略无法访问的目录
+        return;
+    }
+    
+    auto count_file = [&](const struct stat& st) {
+        totals.file_count += 1;
+        if (!names_only && S_ISREG(st.st_mode)) {
+            totals.size += static_cast<uintmax_t>(st.st_size);
+        }
+    };
+    
+    vector<string> subdirs;
+    for (auto& entry : entries) {
+        if (entry.type == DT_DIR) {
+            totals.dir_count += 1;
+            subdirs.push_back(std::move(entry.name));
+            continue;
+        }
+        
+        struct stat st;
+        if (entry.type == DT_UNKNOWN) {
+            if (::fstatat(handle->fd(), entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                totals.dir_count += 1;
+                subdirs.push_back(std::move(entry.name));
+                continue;
+            }
+            if (names_only || !S_ISLNK(st.st_mode)) {
+                count_file(st);
+                continue;
+            }
+        } else if (names_only || (entry.type != DT_REG && entry.type != DT_LNK)) {
+            // 设备、管道等，或只要名称时：只计数
+            totals.file_count += 1;
+            continue;
+        }
+        
+        // 与recursive_directory_iterator一致：跟随符号链接取目标信息，但不进入指向目录的链接
+        if (::fstatat(handle->fd(), entry.name.c_str(), &st, 0) != 0) {
+            // 悬空链接：recursive_directory_iterator将其计为文件（无大小）
+            totals.file_count += 1;
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            totals.dir_count += 1;
+        } else {
+            count_file(st);
+        }
+    }
+    
+    bool retained = !subdirs.empty() && ctx.fd_budget.try_acquire();
+    if (retained) {
+        handle->retain(&ctx.fd_budget);
+    } else {
+        handle.reset();
+    }
+    
+    for (const auto& subdir : subdirs) {
+        measure_subtree(join_path(path, subdir), subdir, handle.get(), ctx, names_only, totals);
+    }
+}
+
+#endif
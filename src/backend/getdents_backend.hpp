@@ -0,0 +1,79 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#ifdef __linux__
+
+#include <sys/stat.h>
+
+// 已打开的目录fd（RAII）。保留给子目录openat使用时占用FdBudget中的一个名额
+class DirHandle {
+public:
+    explicit DirHandle(int fd) : fd_(fd) {}
+    ~DirHandle();
+    
+    DirHandle(const DirHandle&) = delete;
+    DirHandle& operator=(const DirHandle&) = delete;
+    
+    int fd() const { return fd_; }
+    
+    // 标记为保留（析构时归还名额）
+    void retain(FdBudget* budget) { budget_ = budget; }
+    bool retained() const { return budget_ != nullptr; }
+    
+private:
+    int fd_;
+    FdBudget* budget_ = nullptr;
+};
+
+// Linux遍历后端：getdents64把目录项批量读入大缓冲区，
+// fstatat相对已打开的目录fd获取元数据，完整路径只在输出条目时拼接一次。
+// ScanBackend::IoUring时，一个目录的stat和子目录的打开通过io_uring批量提交
+class GetdentsBackend {
+public:
+    // opened: 已预先打开的本目录（可能为空，此时自行打开）
+    // names_only: 本目录是否只列名称（选项或挂载点规则）
+    static DirListing list_directory(const fs::path& path, 
+                                     ScanContext& ctx,
+                                     int depth,
+                                     bool names_only,
+                                     const std::shared_ptr<DirHandle>& parent,
+                                     std::shared_ptr<DirHandle> opened);
+    
+private:
+    struct RawEntry {
+        std::string name;
+        unsigned char type;  // d_type
+    };
+    
+    // 打开目录：父目录仍打开时使用openat，否则使用完整路径
+    static std::shared_ptr<DirHandle> open_directory(const std::string& path, 
+                                                     const std::string& name,
+                                                     const DirHandle* parent);
+    
+    // 读取目录中的所有条目（不含 . 和 ..）
+    static void read_entries(int fd, const std::string& path, std::vector<RawEntry>& entries);
+    
+    // 统计被裁剪子树的大小与数量
+    static void measure_subtree(const std::string& path, 
+                                const std::string& name,
+                                const DirHandle* parent,
+                                ScanContext& ctx,
+                                bool names_only,
+                                SubtreeTotals& totals);
+    
+    // io_uring：批量stat所有条目（不可用时返回false）
+    static bool prefetch_stats(const ScanContext& ctx,
+                               int dirfd,
+                               bool follow,
+                               const std::vector<RawEntry>& entries,
+                               std::vector<struct stat>& results,
+                               std::vector<int>& errors);
+    
+    // io_uring：在fd名额允许的范围内批量打开子目录，结果放入SubdirEntry::handle
+    static void prefetch_subdirs(ScanContext& ctx, int dirfd, std::vector<SubdirEntry>& subdirs);
+    
+    static fs::file_time_type to_file_time(const struct timespec& ts);
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "io_uring_queue.hpp"
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <linux/io_uring.h>
+
+using namespace std;
+
+namespace {
+
+// 一旦io_uring_setup失败（旧内核、seccomp等），整个进程不再尝试
+atomic<bool> io_uring_unavailable{false};
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+void to_stat(const struct statx& stx, struct stat& st) {
+    memset(&st, 0, sizeof(st));
+    st.st_mode = stx.stx_mode;
+    st.st_size = static_cast<off_t>(stx.stx_size);
+    st.st_nlink = stx.stx_nlink;
+    st.st_uid = stx.stx_uid;
+    st.st_gid = stx.stx_gid;
+    st.st_ino = stx.stx_ino;
+    st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    st.st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+    st.st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+}
+
+}  // namespace
+
+IoUringQueue* IoUringQueue::for_current_thread(unsigned queue_depth) {
+    if (io_uring_unavailable.load(memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    thread_local unique_ptr<IoUringQueue> queue;
+    if (queue && queue->depth_ != queue_depth) {
+        queue.reset();
+    }
+    if (!queue) {
+        queue.reset(new IoUringQueue(queue_depth));
+        if (queue->ring_fd_ < 0) {
+            int err = errno;
+            queue.reset();
+            if (!io_uring_unavailable.exchange(true)) {
+                cerr << "Warning: io_uring unavailable (" << strerror(err)
+                     << "), falling back to synchronous stat" << endl;
+            }
+            return nullptr;
+        }
+    }
+    return queue->broken_ ? nullptr : queue.get();
+}
+
+IoUringQueue::IoUringQueue(unsigned queue_depth) : depth_(queue_depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = sys_io_uring_setup(queue_depth, &params);
+    if (fd < 0) {
+        return;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        ::close(fd);
+        return;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            ::munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = nullptr;
+            ::close(fd);
+            return;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        if (cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        ::munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = cq_ring_ = nullptr;
+        ::close(fd);
+        return;
+    }
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+
+    // 内核可能把队列长度向上取整，在途请求数仍以请求的深度为准
+    depth_ = queue_depth;
+    ring_fd_ = fd;
+}
+
+IoUringQueue::~IoUringQueue() {
+    if (sqes_) {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+}
+
+template <typename Prepare, typename Complete>
+void IoUringQueue::run_batch(size_t count, Prepare prepare, Complete complete) {
+    auto* sqes = static_cast<io_uring_sqe*>(sqes_);
+    auto* cqes = static_cast<io_uring_cqe*>(cqes_);
+    const unsigned limit = min(depth_, sq_mask_ + 1);
+
+    size_t next = 0;
+    size_t completed = 0;
+    unsigned in_flight = 0;
+    unsigned unsubmitted = 0;  // 已放入SQ但内核尚未取走的请求
+
+    while (completed < count) {
+        // 补满队列
+        unsigned tail = *sq_tail_;
+        while (next < count && in_flight < limit) {
+            unsigned index = tail & sq_mask_;
+            io_uring_sqe* sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            prepare(sqe, next);
+            sqe->user_data = next;
+            sq_array_[index] = index;
+            tail++;
+            next++;
+            in_flight++;
+            unsubmitted++;
+        }
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+        int ret = sys_io_uring_enter(ring_fd_, unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            // 无法继续：剩余请求交给调用方同步处理，此后不再使用该队列
+            int err = errno;
+            cerr << "Warning: io_uring_enter failed (" << strerror(err)
+                 << "), falling back to synchronous stat" << endl;
+            broken_ = true;
+            for (size_t i = completed; i < count; i++) {
+                complete(i, -EOPNOTSUPP);
+            }
+            return;
+        }
+        unsubmitted -= min(unsubmitted, static_cast<unsigned>(ret));
+
+        // 收取完成事件
+        unsigned head = *cq_head_;
+        unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        while (head != cq_tail) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask_];
+            complete(static_cast<size_t>(cqe.user_data), cqe.res);
+            head++;
+            completed++;
+            in_flight--;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+}
+
+void IoUringQueue::stat_batch(int dirfd,
+                              const vector<const char*>& names,
+                              vector<struct stat>& results,
+                              vector<int>& errors,
+                              bool follow) {
+    const size_t count = names.size();
+    results.resize(count);
+    errors.assign(count, 0);
+    const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+
+    vector<struct statx> buffers(count);
+    run_batch(count,
+        [&](io_uring_sqe* sqe, size_t i) {
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dirfd;
+            sqe->addr = reinterpret_cast<uint64_t>(names[i]);
+            sqe->len = STATX_BASIC_STATS;
+            sqe->off = reinterpret_cast<uint64_t>(&buffers[i]);
+            sqe->statx_flags = flags;  // 与fstatat的flags含义相同
+        },
+        [&](size_t i, int res) {
+            if (res == -EINVAL || res == -EOPNOTSUPP) {
+                // 内核不支持IORING_OP_STATX（5.6之前）或文件系统不支持：同步补上
+                errors[i] = ::fstatat(dirfd, names[i], &results[i], flags) == 0 ? 0 : errno;
+            } else if (res < 0) {
+                errors[i] = -res;
+            } else {
+                to_stat(buffers[i], results[i]);
+            }
+        });
+}
+
+void IoUringQueue::open_directory_batch(int dirfd,
+                                        const vector<const char*>& names,
+                                        vector<int>& fds) {
+    const size_t count = names.size();
+    fds.assign(count, -EBADF);
+
+    run_batch(count,
+        [&](io_uring_sqe* sqe, size_t i) {
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = dirfd;
+            sqe->addr = reinterpret_cast<uint64_t>(names[i]);
+            sqe->open_flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+        },
+        [&](size_t i, int res) {
+            fds[i] = res;
+        });
+}
+
+#endif
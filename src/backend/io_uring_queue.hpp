@@ -0,0 +1,67 @@
+#pragma once
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+
+#include <cstddef>
+#include <vector>
+#include <sys/stat.h>
+
+// io_uring批量元数据请求（Linux，getdents后端在ScanBackend::IoUring时使用）
+//
+// 在NFS/FUSE等高延迟文件系统上，每个stat都是一次同步往返。这里把一个目录中
+// 所有条目的IORING_OP_STATX（以及子目录的IORING_OP_OPENAT）一次提交，保持
+// 最多queue_depth个请求同时在途。每个扫描线程使用自己的ring。
+// 内核不支持io_uring（或被seccomp禁止）时for_current_thread返回nullptr，
+// 调用方回退到同步的fstatat/openat
+class IoUringQueue {
+public:
+    // 当前线程的队列；不可用时返回nullptr
+    static IoUringQueue* for_current_thread(unsigned queue_depth);
+
+    ~IoUringQueue();
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    // 相对dirfd对names逐个statx（等价于fstatat；follow为false时带AT_SYMLINK_NOFOLLOW）
+    // errors[i]为0表示成功，否则为errno
+    void stat_batch(int dirfd,
+                    const std::vector<const char*>& names,
+                    std::vector<struct stat>& results,
+                    std::vector<int>& errors,
+                    bool follow = true);
+
+    // 相对dirfd打开names中的目录，fds[i] < 0 时为-errno
+    void open_directory_batch(int dirfd,
+                              const std::vector<const char*>& names,
+                              std::vector<int>& fds);
+
+private:
+    explicit IoUringQueue(unsigned queue_depth);
+
+    // 提交count个请求并收齐结果：prepare(sqe, i)填写第i个请求，complete(i, res)处理结果
+    template <typename Prepare, typename Complete>
+    void run_batch(size_t count, Prepare prepare, Complete complete);
+
+    int ring_fd_ = -1;
+    unsigned depth_ = 0;  // 同时在途的请求数上限
+    bool broken_ = false;  // io_uring_enter出错后不再使用
+
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    void* cqes_ = nullptr;
+};
+
+#endif
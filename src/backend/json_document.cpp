@@ -0,0 +1,333 @@
+#include "json_document.hpp"
+
+using namespace std;
+
+namespace {
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// \u之后的4位十六进制数
+bool read_hex4(string_view text, size_t& pos, unsigned& code) {
+    if (text.size() - pos < 4) {
+        return false;
+    }
+    code = 0;
+    for (int i = 0; i < 4; i++) {
+        const int digit = hex_value(text[pos + i]);
+        if (digit < 0) {
+            return false;
+        }
+        code = code * 16 + static_cast<unsigned>(digit);
+    }
+    pos += 4;
+    return true;
+}
+
+void append_utf8(string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+}
+
+bool JsonDocument::parse(string_view text, string* error) {
+    source_ = text;
+    nodes_.clear();
+    decoded_.clear();
+
+    size_t pos = 0;
+    const char* failure = nullptr;
+    if (text.size() >= UINT32_MAX) {
+        failure = "document too large";
+    } else {
+        skip_whitespace(pos);
+        if (parse_value(pos, 0, Slice(), failure)) {
+            skip_whitespace(pos);
+            if (pos < text.size()) {
+                failure = "unexpected characters after the value";
+            }
+        }
+    }
+
+    if (failure) {
+        if (error) {
+            *error = string(failure) + " at offset " + to_string(pos);
+        }
+        nodes_.clear();
+        decoded_.clear();
+        return false;
+    }
+    return true;
+}
+
+size_t JsonDocument::find(size_t object, string_view key) const {
+    if (object >= nodes_.size() || nodes_[object].type != JsonType::Object) {
+        return kNotFound;
+    }
+    size_t found = kNotFound;
+    for (size_t i = object + 1; i < nodes_[object].end; i = nodes_[i].end) {
+        if (slice(nodes_[i].key) == key) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+void JsonDocument::skip_whitespace(size_t& pos) const {
+    while (pos < source_.size() &&
+           (source_[pos] == ' ' || source_[pos] == '\t' || source_[pos] == '\n' || source_[pos] == '\r')) {
+        pos++;
+    }
+}
+
+bool JsonDocument::parse_value(size_t& pos, int depth, const Slice& key, const char*& failure) {
+    if (pos >= source_.size()) {
+        failure = "unexpected end of input";
+        return false;
+    }
+
+    // 子值追加时nodes_可能重新分配，之后只用下标访问
+    const size_t index = nodes_.size();
+    nodes_.push_back(Node{JsonType::Null, key, Slice(), 0});
+
+    const char c = source_[pos];
+    if (c == '{' || c == '[') {
+        if (depth >= kMaxNesting) {
+            failure = "nesting too deep";
+            return false;
+        }
+        const bool object = c == '{';
+        const char close = object ? '}' : ']';
+        nodes_[index].type = object ? JsonType::Object : JsonType::Array;
+        pos++;
+        skip_whitespace(pos);
+        if (pos < source_.size() && source_[pos] == close) {
+            pos++;
+        } else {
+            while (true) {
+                Slice member_key;
+                if (object) {
+                    if (pos >= source_.size() || source_[pos] != '"') {
+                        failure = "expected a string key";
+                        return false;
+                    }
+                    if (!parse_string(pos, member_key, failure)) {
+                        return false;
+                    }
+                    skip_whitespace(pos);
+                    if (pos >= source_.size() || source_[pos] != ':') {
+                        failure = "expected ':'";
+                        return false;
+                    }
+                    pos++;
+                    skip_whitespace(pos);
+                }
+                if (!parse_value(pos, depth + 1, member_key, failure)) {
+                    return false;
+                }
+                skip_whitespace(pos);
+                if (pos < source_.size() && source_[pos] == ',') {
+                    pos++;
+                    skip_whitespace(pos);
+                } else if (pos < source_.size() && source_[pos] == close) {
+                    pos++;
+                    break;
+                } else {
+                    failure = object ? "expected ',' or '}'" : "expected ',' or ']'";
+                    return false;
+                }
+            }
+        }
+    } else if (c == '"') {
+        Slice text;
+        if (!parse_string(pos, text, failure)) {
+            return false;
+        }
+        nodes_[index].type = JsonType::String;
+        nodes_[index].text = text;
+    } else if (c == '-' || is_digit(c)) {
+        const size_t begin = pos;
+        if (!parse_number(pos, failure)) {
+            return false;
+        }
+        nodes_[index].type = JsonType::Number;
+        nodes_[index].text = Slice{static_cast<uint32_t>(begin), static_cast<uint32_t>(pos - begin), false};
+    } else {
+        static const struct {
+            string_view literal;
+            JsonType type;
+        } kLiterals[] = {{"true", JsonType::Bool}, {"false", JsonType::Bool}, {"null", JsonType::Null}};
+        bool matched = false;
+        for (const auto& literal : kLiterals) {
+            if (source_.compare(pos, literal.literal.size(), literal.literal) == 0) {
+                nodes_[index].type = literal.type;
+                nodes_[index].text = Slice{static_cast<uint32_t>(pos), 
+                                           static_cast<uint32_t>(literal.literal.size()), false};
+                pos += literal.literal.size();
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            failure = "invalid value";
+            return false;
+        }
+    }
+
+    nodes_[index].end = static_cast<uint32_t>(nodes_.size());
+    return true;
+}
+
+bool JsonDocument::parse_string(size_t& pos, Slice& out, const char*& failure) {
+    const size_t begin = ++pos;
+
+    // 没有转义时直接引用原文
+    while (pos < source_.size()) {
+        const unsigned char c = static_cast<unsigned char>(source_[pos]);
+        if (c == '"') {
+            out = Slice{static_cast<uint32_t>(begin), static_cast<uint32_t>(pos - begin), false};
+            pos++;
+            return true;
+        }
+        if (c == '\\') {
+            break;
+        }
+        if (c < 0x20) {
+            failure = "control character in string";
+            return false;
+        }
+        pos++;
+    }
+
+    // 有转义：连同之前的部分解码到decoded_
+    const size_t offset = decoded_.size();
+    decoded_.append(source_.data() + begin, pos - begin);
+    while (pos < source_.size()) {
+        const unsigned char c = static_cast<unsigned char>(source_[pos]);
+        if (c == '"') {
+            out = Slice{static_cast<uint32_t>(offset), static_cast<uint32_t>(decoded_.size() - offset), true};
+            pos++;
+            return true;
+        }
+        if (c < 0x20) {
+            failure = "control character in string";
+            return false;
+        }
+        if (c != '\\') {
+            // 到下一个引号、转义或控制字符为止的一段原样复制
+            size_t run_end = pos + 1;
+            while (run_end < source_.size() && source_[run_end] != '"' && source_[run_end] != '\\' &&
+                   static_cast<unsigned char>(source_[run_end]) >= 0x20) {
+                run_end++;
+            }
+            decoded_.append(source_.data() + pos, run_end - pos);
+            pos = run_end;
+            continue;
+        }
+
+        if (++pos >= source_.size()) {
+            break;
+        }
+        switch (source_[pos++]) {
+            case '"':  decoded_ += '"';  break;
+            case '\\': decoded_ += '\\'; break;
+            case '/':  decoded_ += '/';  break;
+            case 'b':  decoded_ += '\b'; break;
+            case 'f':  decoded_ += '\f'; break;
+            case 'n':  decoded_ += '\n'; break;
+            case 'r':  decoded_ += '\r'; break;
+            case 't':  decoded_ += '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!read_hex4(source_, pos, code)) {
+                    failure = "invalid \\u escape";
+                    return false;
+                }
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    // 高代理项后须紧跟低代理项，合成一个码点
+                    size_t next = pos + 2;
+                    unsigned low;
+                    if (source_.compare(pos, 2, "\\u") == 0 && read_hex4(source_, next, low) &&
+                        low >= 0xDC00 && low <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        pos = next;
+                    } else {
+                        code = 0xFFFD;
+                    }
+                } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                    code = 0xFFFD;
+                }
+                append_utf8(decoded_, code);
+                break;
+            }
+            default:
+                pos--;
+                failure = "invalid escape";
+                return false;
+        }
+    }
+
+    failure = "unterminated string";
+    return false;
+}
+
+bool JsonDocument::parse_number(size_t& pos, const char*& failure) {
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    auto digits = [&]() {
+        const size_t begin = pos;
+        while (pos < source_.size() && is_digit(source_[pos])) {
+            pos++;
+        }
+        return pos > begin;
+    };
+
+    if (source_[pos] == '-') {
+        pos++;
+    }
+    if (pos < source_.size() && source_[pos] == '0') {
+        pos++;
+    } else if (!digits()) {
+        failure = "invalid number";
+        return false;
+    }
+    if (pos < source_.size() && source_[pos] == '.') {
+        pos++;
+        if (!digits()) {
+            failure = "invalid number";
+            return false;
+        }
+    }
+    if (pos < source_.size() && (source_[pos] == 'e' || source_[pos] == 'E')) {
+        pos++;
+        if (pos < source_.size() && (source_[pos] == '+' || source_[pos] == '-')) {
+            pos++;
+        }
+        if (!digits()) {
+            failure = "invalid number";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 请求体的JSON解析：一次遍历，所有值按出现顺序（先序）放进一个数组，
+// 数组和对象记下其子树的结束位置，与ScanResult的子树范围相同。
+//   - 没有转义的字符串（绝大多数）直接引用原文，有转义的解码到一块共用的缓冲
+//   - \uXXXX（包括代理对）解码为UTF-8，单独的代理项换成U+FFFD；原文中的UTF-8字节原样保留
+//   - 数字保留原文，由调用方按需要的类型转换
+//
+// 文档引用解析的文本，文本须比文档存活得久
+enum class JsonType : uint8_t {
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object,
+};
+
+class JsonDocument {
+public:
+    static constexpr size_t kNotFound = SIZE_MAX;
+    static constexpr int kMaxNesting = 64;  // 数组和对象最多嵌套的层数
+
+    // 解析text：整个文本须是一个JSON值（前后可以有空白）。
+    // 格式错误时返回false，文档为空，error为原因和字节位置
+    bool parse(std::string_view text, std::string* error = nullptr);
+
+    // 值的个数，根为0
+    size_t size() const { return nodes_.size(); }
+    bool empty() const { return nodes_.empty(); }
+
+    JsonType type(size_t i) const { return nodes_[i].type; }
+    // 字符串为解码后的内容，数字为原文，true/false/null为其字面
+    std::string_view text(size_t i) const { return slice(nodes_[i].text); }
+    // 对象成员的键（解码后），其他值为空
+    std::string_view key(size_t i) const { return slice(nodes_[i].key); }
+    bool is_true(size_t i) const { return type(i) == JsonType::Bool && text(i) == "true"; }
+
+    // 值i及其所有子孙占据[i, end(i))。直接子值依次为
+    //   for (size_t c = i + 1; c < document.end(i); c = document.end(c))
+    size_t end(size_t i) const { return nodes_[i].end; }
+
+    // 对象object中键为key的成员（重复时取最后一个），没有或object不是对象时返回kNotFound
+    size_t find(size_t object, std::string_view key) const;
+
+private:
+    // 原文或解码缓冲中的一段
+    struct Slice {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        bool decoded = false;
+    };
+
+    struct Node {
+        JsonType type;
+        Slice key;
+        Slice text;
+        uint32_t end;
+    };
+
+    std::string_view slice(const Slice& s) const {
+        return std::string_view((s.decoded ? decoded_.data() : source_.data()) + s.offset, s.length);
+    }
+
+    bool parse_value(size_t& pos, int depth, const Slice& key, const char*& failure);
+    bool parse_string(size_t& pos, Slice& out, const char*& failure);
+    bool parse_number(size_t& pos, const char*& failure);
+    void skip_whitespace(size_t& pos) const;
+
+    std::string_view source_;
+    std::vector<Node> nodes_;
+    std::string decoded_;
+};
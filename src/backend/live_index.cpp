@@ -0,0 +1,304 @@
+#include "live_index.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+#ifdef __linux__
+// 影响目录列表或条目大小/时间的事件
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | 
+                                IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+constexpr size_t kEventBufferSize = 64 * 1024;
+#endif
+
+string join_path(const string& dir, const string& name) {
+    string full = dir;
+    if (full.empty() || full.back() != '/') {
+        full += '/';
+    }
+    full += name;
+    return full;
+}
+
+FileTreeOptions watch_options(const FileTreeOptions& options) {
+    // 后台重新扫描不受单次请求的限制
+    FileTreeOptions result = options;
+    result.time_limit_ms = 0;
+    result.max_entries = 0;
+    result.cancel_token.reset();
+    return result;
+}
+
+}  // namespace
+
+unique_ptr<LiveIndex> LiveIndex::start(shared_ptr<const ScanSnapshot> snapshot,
+                                       const FileTreeOptions& options,
+                                       const ScanStats& stats) {
+#ifdef __linux__
+    // count_hardlinks_once的结果不能按目录增量更新
+    if (!snapshot || !snapshot->complete() || options.count_hardlinks_once) {
+        return nullptr;
+    }
+    
+    unique_ptr<LiveIndex> index(new LiveIndex(std::move(snapshot), options, stats));
+    if (index->inotify_fd_ < 0 || index->wake_fd_ < 0) {
+        cerr << "Warning: Cannot watch " << index->root_ << ": " << strerror(errno) << endl;
+        return nullptr;
+    }
+    
+    {
+        lock_guard<mutex> lock(index->mutex_);
+        index->watch_snapshot();
+    }
+    index->thread_ = thread(&LiveIndex::run, index.get());
+    return index;
+#else
+    return nullptr;
+#endif
+}
+
+LiveIndex::LiveIndex(shared_ptr<const ScanSnapshot> snapshot, const FileTreeOptions& options, const ScanStats& stats)
+    : snapshot_(std::move(snapshot)),
+      stats_(stats),
+      options_(watch_options(options)),
+      context_(options_, snapshot_->root()),
+      root_(snapshot_->root()) {
+#ifdef __linux__
+    inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+LiveIndex::~LiveIndex() {
+#ifdef __linux__
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+        (void)written;
+        thread_.join();
+    }
+    // 关闭inotify fd即移除所有监视
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+#endif
+}
+
+bool LiveIndex::compatible(const string& root, const FileTreeOptions& options) const {
+    lock_guard<mutex> lock(mutex_);
+    return snapshot_->compatible(root, options);
+}
+
+shared_ptr<const ScanSnapshot> LiveIndex::query(ScanStats* stats) {
+    lock_guard<mutex> query_lock(query_mutex_);
+    
+    shared_ptr<const ScanSnapshot> previous;
+    unordered_set<string> changed;
+    bool by_stamp;
+    {
+        lock_guard<mutex> lock(mutex_);
+        previous = snapshot_;
+        by_stamp = resync_ || degraded_;
+        if (!by_stamp && dirty_.empty()) {
+            // 没有任何事件：直接使用内存中的结果
+            if (stats) {
+                *stats = stats_;
+                stats->dirs_read = 0;
+                stats->dirs_reused = 0;
+            }
+            return previous;
+        }
+        
+        for (int wd : dirty_) {
+            auto it = watches_.find(wd);
+            if (it != watches_.end()) {
+                changed.insert(it->second);
+            }
+        }
+        dirty_.clear();
+        resync_ = false;
+    }
+    
+    // 扫描期间到达的事件记入新的脏目录集合，下一次查询时处理
+    ScanStats new_stats;
+    shared_ptr<const ScanSnapshot> next = FileSystemScanner::rescan_directory(
+        root_, options_, previous.get(), &new_stats, by_stamp ? nullptr : &changed);
+    
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (next->complete()) {
+            snapshot_ = next;
+            stats_ = new_stats;
+            // 事件可能丢失：期间新建的目录还没有监视
+            if (by_stamp) {
+                watch_snapshot();
+            }
+        } else {
+            resync_ = true;
+        }
+    }
+    
+    if (stats) {
+        *stats = new_stats;
+    }
+    return next;
+}
+
+void LiveIndex::add_watch(const string& path) {
+#ifdef __linux__
+    if (degraded_) {
+        return;
+    }
+    
+    int wd = ::inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+    if (wd < 0) {
+        if (errno == ENOSPC || errno == ENOMEM) {
+            cerr << "Warning: inotify watch limit reached while watching " << root_ 
+                 << ", falling back to rescans (raise fs.inotify.max_user_watches)" << endl;
+            degraded_ = true;
+        }
+        // 其他错误（例如目录已被删除）忽略：父目录的事件会让它被重新读取
+        return;
+    }
+    watches_[wd] = path;
+#endif
+}
+
+bool LiveIndex::should_watch(const string& path, int depth) const {
+    if (options_.max_depth >= 0 && depth > options_.max_depth) {
+        return false;
+    }
+    size_t slash = path.find_last_of('/');
+    string_view name = slash == string::npos ? string_view(path) : string_view(path).substr(slash + 1);
+    return !context_.is_excluded(name, path, true);
+}
+
+void LiveIndex::watch_tree(const string& path, int depth) {
+    if (!should_watch(path, depth)) {
+        return;
+    }
+    add_watch(path);
+    
+    // 监视建立之前就已创建的子目录
+    error_code ec;
+    for (fs::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec) && !it->is_symlink(ec)) {
+            watch_tree(it->path().string(), depth + 1);
+        }
+    }
+}
+
+void LiveIndex::unwatch_tree(const string& path) {
+#ifdef __linux__
+    const string prefix = join_path(path, string());
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        if (it->second == path || it->second.compare(0, prefix.size(), prefix) == 0) {
+            ::inotify_rm_watch(inotify_fd_, it->first);
+            dirty_.erase(it->first);
+            it = watches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#endif
+}
+
+void LiveIndex::watch_snapshot() {
+    add_watch(root_);
+    const ScanResult& result = snapshot_->result();
+    for (size_t i = 0; i < result.size() && !degraded_; i++) {
+        if (result.is_directory(i)) {
+            add_watch(result.path(i));
+        }
+    }
+}
+
+void LiveIndex::handle_events(const char* buffer, long length) {
+#ifdef __linux__
+    for (long offset = 0; offset < length;) {
+        const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+        offset += sizeof(struct inotify_event) + event->len;
+        
+        if (event->mask & IN_Q_OVERFLOW) {
+            resync_ = true;
+            continue;
+        }
+        
+        auto it = watches_.find(event->wd);
+        if (it == watches_.end()) {
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            dirty_.erase(event->wd);
+            watches_.erase(it);
+            continue;
+        }
+        
+        const string dir = it->second;
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+            // 其他目录由父目录的事件处理；根目录本身没有父目录
+            if (dir == root_) {
+                resync_ = true;
+            }
+            continue;
+        }
+        
+        dirty_.insert(event->wd);
+        
+        if ((event->mask & IN_ISDIR) && event->len > 0) {
+            string child = join_path(dir, event->name);
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                string_view rel = string_view(child).substr(min(context_.root_prefix, child.size()));
+                int depth = 1 + static_cast<int>(count(rel.begin(), rel.end(), '/'));
+                watch_tree(child, depth);
+            } else if (event->mask & IN_MOVED_FROM) {
+                unwatch_tree(child);
+            }
+        }
+    }
+#endif
+}
+
+void LiveIndex::run() {
+#ifdef __linux__
+    vector<char> buffer(kEventBufferSize);
+    struct pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    
+    while (true) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        
+        while (true) {
+            long bytes = ::read(inotify_fd_, buffer.data(), buffer.size());
+            if (bytes <= 0) {
+                break;
+            }
+            lock_guard<mutex> lock(mutex_);
+            handle_events(buffer.data(), bytes);
+        }
+    }
+#endif
+}
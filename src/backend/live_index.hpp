@@ -0,0 +1,81 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "scan_snapshot.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// 实时索引：对一次完整扫描的每个已列出目录注册inotify监视（Linux），
+// 后台线程把增删、重命名、修改事件记为“脏目录”。查询时没有事件则直接返回
+// 内存中的快照；有事件则只重新读取脏目录（rescan_directory的changed_dirs），
+// 其余目录不stat。目录大小随之自底向上重新汇总
+//
+// 事件队列溢出或目录被整体移走时，下一次查询退回按目录标识的增量扫描并重新注册监视；
+// 监视数达到上限（max_user_watches）时，该根目录之后的每次查询都按目录标识增量扫描。
+// 被排除规则/max_depth裁剪的子树不监视，其汇总只在所在目录变化时更新。
+// 需要CAP_SYS_ADMIN的fanotify不使用
+class LiveIndex {
+public:
+    // 为已完成的扫描建立监视。平台不支持或inotify不可用时返回nullptr
+    static std::unique_ptr<LiveIndex> start(std::shared_ptr<const ScanSnapshot> snapshot,
+                                            const FileTreeOptions& options,
+                                            const ScanStats& stats);
+
+    ~LiveIndex();
+
+    LiveIndex(const LiveIndex&) = delete;
+    LiveIndex& operator=(const LiveIndex&) = delete;
+
+    // 是否可以回答这次扫描：根目录和影响列出内容的选项相同
+    bool compatible(const std::string& root, const FileTreeOptions& options) const;
+
+    // 当前的扫描结果。stats中的dirs_read/dirs_reused为本次查询重新读取/复用的目录数
+    std::shared_ptr<const ScanSnapshot> query(ScanStats* stats = nullptr);
+
+private:
+    LiveIndex(std::shared_ptr<const ScanSnapshot> snapshot, const FileTreeOptions& options, const ScanStats& stats);
+
+    // 以下在持有mutex_时调用
+    
+    // 监视一个目录
+    void add_watch(const std::string& path);
+
+    // 监视新出现的目录及其下所有应列出的子目录
+    void watch_tree(const std::string& path, int depth);
+
+    // 移除path及其下所有目录的监视（目录被移走）
+    void unwatch_tree(const std::string& path);
+
+    // 为快照中的所有目录注册监视（已监视的目录inotify返回原有的wd）
+    void watch_snapshot();
+
+    void handle_events(const char* buffer, long length);
+    
+    // 后台线程：读取事件
+    void run();
+
+    // 新出现的目录是否会被扫描列出（深度和排除规则）
+    bool should_watch(const std::string& path, int depth) const;
+
+    std::mutex query_mutex_;  // 串行化查询（重新扫描）
+
+    // 以下由mutex_保护
+    mutable std::mutex mutex_;
+    std::shared_ptr<const ScanSnapshot> snapshot_;
+    ScanStats stats_;
+    std::unordered_map<int, std::string> watches_;  // wd -> 目录路径
+    std::unordered_set<int> dirty_;  // 有事件的目录
+    bool resync_ = false;  // 事件可能丢失：下次查询按目录标识增量扫描
+    bool degraded_ = false;  // 监视数达到上限：每次查询都按目录标识增量扫描
+
+    FileTreeOptions options_;  // 不含时间/条目数限制和取消标志
+    ScanContext context_;  // 用于判断新目录是否被排除
+    std::string root_;
+    int inotify_fd_ = -1;
+    int wake_fd_ = -1;  // 析构时唤醒后台线程
+    std::thread thread_;
+};
@@ -21,11 +21,16 @@ void print_help() {
     cout << "File Manager Web GUI" << endl;
     cout << "=====================" << endl;
     cout << "Usage:" << endl;
-    cout << "  ./filemanager [port]" << endl;
+    cout << "  ./filemanager [port] [options]" << endl;
     cout << endl;
     cout << "Arguments:" << endl;
     cout << "  port      Port number for the web server (default: 8080)" << endl;
     cout << endl;
+    cout << "Options:" << endl;
+    cout << "  --gzip-level N         gzip level for API responses, 1-9, 0 disables (default: 6)" << endl;
+    cout << "  --zstd-level N         zstd level for API responses, 1-19, 0 disables (default: 3)" << endl;
+    cout << "  --compress-min-size N  Do not compress responses smaller than N bytes (default: 1024)" << endl;
+    cout << endl;
     cout << "Features:" << endl;
     cout << "  • Modern web-based GUI" << endl;
     cout << "  • Folder upload and scanning" << endl;
@@ -43,22 +48,43 @@ int main(int argc, char* argv[]) {
     
     // 解析命令行参数
     int port = 8080;
+    CompressionSettings compression;
     
-    if (argc > 1) {
-        string arg1 = argv[1];
-        if (arg1 == "--help" || arg1 == "-h") {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
             print_help();
             return 0;
         }
         
         try {
-            port = stoi(arg1);
+            if (arg == "--gzip-level" || arg == "--zstd-level" || arg == "--compress-min-size") {
+                if (i + 1 >= argc) {
+                    cerr << "Error: " << arg << " requires a value" << endl;
+                    return 1;
+                }
+                const int value = stoi(argv[++i]);
+                if (value < 0) {
+                    cerr << "Error: " << arg << " must not be negative" << endl;
+                    return 1;
+                }
+                if (arg == "--gzip-level") {
+                    compression.gzip_level = value;
+                } else if (arg == "--zstd-level") {
+                    compression.zstd_level = value;
+                } else {
+                    compression.min_size = static_cast<size_t>(value);
+                }
+                continue;
+            }
+            
+            port = stoi(arg);
             if (port < 1 || port > 65535) {
                 cerr << "Error: Port must be between 1 and 65535" << endl;
                 return 1;
             }
         } catch (const exception&) {
-            cerr << "Error: Invalid port number" << endl;
+            cerr << "Error: Invalid argument " << arg << endl;
             print_help();
             return 1;
         }
@@ -86,6 +112,7 @@ int main(int argc, char* argv[]) {
     
     // 创建并启动Web服务器
     WebServer server;
+    server.set_compression(compression);
     
     if (!server.start(port)) {
         cerr << "Failed to start web server" << endl;
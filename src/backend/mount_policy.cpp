@@ -0,0 +1,246 @@
+#include "mount_policy.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+// 伪文件系统：内容由内核生成，大小没有意义，/proc/kcore之类还会报告巨大的大小
+const char* const kPseudoTypes[] = {
+    "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs", "debugfs",
+    "tracefs", "configfs", "pstore", "bpf", "mqueue", "hugetlbfs", "fusectl", "binfmt_misc",
+    "autofs", "efivarfs", "selinuxfs", "nsfs", "rpc_pipefs",
+};
+
+// 网络文件系统：每次stat都是一次网络往返
+const char* const kNetworkTypes[] = {
+    "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "ceph", "glusterfs", "afs", "fuse.sshfs",
+    "fuse.rclone", "fuse.s3fs",
+};
+
+template <size_t N>
+bool contains(const char* const (&types)[N], const string& fstype) {
+    return find_if(begin(types), end(types), [&](const char* type) { return fstype == type; }) != end(types);
+}
+
+// mountinfo中的路径把空格、制表符、换行和反斜杠写成\ooo八进制转义
+string unescape(const string& field) {
+    string out;
+    out.reserve(field.size());
+    for (size_t i = 0; i < field.size(); i++) {
+        if (field[i] == '\\' && i + 3 < field.size() &&
+            field[i + 1] >= '0' && field[i + 1] <= '7' &&
+            field[i + 2] >= '0' && field[i + 2] <= '7' &&
+            field[i + 3] >= '0' && field[i + 3] <= '7') {
+            out.push_back(static_cast<char>((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0')));
+            i += 3;
+        } else {
+            out.push_back(field[i]);
+        }
+    }
+    return out;
+}
+
+// 去掉末尾的分隔符（根目录"/"变为空串），便于拼接和比较前缀
+string trim_separator(string path) {
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+// path是否为prefix本身或其下的路径（prefix已去掉末尾分隔符）
+bool is_under(string_view path, string_view prefix) {
+    return path.size() >= prefix.size() &&
+           path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == '/');
+}
+
+}
+
+MountPolicies::MountPolicies(const vector<string>& rules, bool one_filesystem, const string& root) {
+#ifdef _WIN32
+    (void)rules;
+    (void)one_filesystem;
+    (void)root;
+#else
+    vector<Rule> parsed;
+    for (const auto& text : rules) {
+        Rule rule;
+        if (parse_rule(text, rule)) {
+            parsed.push_back(std::move(rule));
+        } else {
+            cerr << "Warning: Ignoring invalid mount policy: " << text << endl;
+        }
+    }
+    if (parsed.empty() && !one_filesystem) {
+        return;
+    }
+
+    vector<MountInfo> table = read_mount_table();
+    if (table.empty()) {
+        return;
+    }
+
+    // 挂载表中是规范路径，扫描路径可能经过符号链接：按相对根目录的部分换算
+    error_code ec;
+    filesystem::path canonical_root = filesystem::canonical(root, ec);
+    if (ec) {
+        return;
+    }
+    const string canonical = trim_separator(canonical_root.string());
+    const string scan_root = trim_separator(root);
+
+    auto action_for = [&](const MountInfo& mount) {
+        for (const auto& rule : parsed) {
+            if (rule_matches(rule, mount)) {
+                return rule.action;
+            }
+        }
+        return MountAction::Scan;
+    };
+
+    // 根目录所在的挂载点：规则同样适用（跳过除外），挂载表中靠后的覆盖靠前的
+    const MountInfo* root_mount = nullptr;
+    for (const auto& mount : table) {
+        const string mount_point = trim_separator(mount.mount_point);
+        if (is_under(canonical, mount_point) &&
+            (!root_mount || mount_point.size() >= trim_separator(root_mount->mount_point).size())) {
+            root_mount = &mount;
+        }
+    }
+
+    bool any_action = false;
+    if (root_mount) {
+        MountAction action = action_for(*root_mount);
+        if (action == MountAction::Skip) {
+            action = MountAction::Scan;
+        }
+        any_action = action != MountAction::Scan;
+        mounts_.push_back({scan_root, root_mount->fstype, action, nullptr});
+    }
+
+    for (const auto& mount : table) {
+        const string mount_point = trim_separator(mount.mount_point);
+        if (mount_point.size() <= canonical.size() || !is_under(mount_point, canonical)) {
+            continue;
+        }
+        MountAction action = one_filesystem ? MountAction::Skip : action_for(mount);
+        any_action = any_action || action != MountAction::Scan;
+
+        string path = scan_root + mount_point.substr(canonical.size());
+        // 同一路径挂载了多次时只有最后一次可见
+        auto same = find_if(mounts_.begin(), mounts_.end(), [&](const Mount& m) { return m.path == path; });
+        if (same != mounts_.end()) {
+            *same = {std::move(path), mount.fstype, action, nullptr};
+        } else {
+            mounts_.push_back({std::move(path), mount.fstype, action, nullptr});
+        }
+    }
+
+    // 全部正常扫描时不必逐个目录查找
+    if (!any_action) {
+        mounts_.clear();
+        return;
+    }
+    for (auto& mount : mounts_) {
+        if (mount.action == MountAction::Throttle) {
+            mount.throttle = make_shared<mutex>();
+        }
+    }
+    stable_sort(mounts_.begin(), mounts_.end(), [](const Mount& a, const Mount& b) {
+        return a.path.size() > b.path.size();
+    });
+#endif
+}
+
+const MountPolicies::Mount* MountPolicies::find(const filesystem::path& dir) const {
+#ifdef _WIN32
+    (void)dir;
+    return nullptr;
+#else
+    const string& path = dir.native();
+    for (const auto& mount : mounts_) {
+        if (is_under(path, mount.path)) {
+            return mount.action == MountAction::Scan ? nullptr : &mount;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+vector<MountInfo> MountPolicies::read_mount_table() {
+    vector<MountInfo> table;
+#ifdef __linux__
+    // 格式：id 父id 主:次 根 挂载点 选项 [可选字段...] - 类型 来源 超级块选项
+    ifstream in("/proc/self/mountinfo");
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string id, parent, device, fs_root, mount_point, field;
+        if (!(fields >> id >> parent >> device >> fs_root >> mount_point)) {
+            continue;
+        }
+        while (fields >> field && field != "-") {
+        }
+        MountInfo mount;
+        if (field != "-" || !(fields >> mount.fstype >> mount.source)) {
+            continue;
+        }
+        mount.mount_point = unescape(mount_point);
+        mount.source = unescape(mount.source);
+        table.push_back(std::move(mount));
+    }
+#endif
+    return table;
+}
+
+const char* MountPolicies::action_name(MountAction action) {
+    switch (action) {
+        case MountAction::Skip: return "skip";
+        case MountAction::NamesOnly: return "names_only";
+        case MountAction::Throttle: return "throttle";
+        default: return "scan";
+    }
+}
+
+bool MountPolicies::parse_rule(const string& text, Rule& rule) {
+    size_t eq = text.rfind('=');
+    if (eq == string::npos || eq == 0) {
+        return false;
+    }
+    rule.pattern = text.substr(0, eq);
+    const string action = text.substr(eq + 1);
+    if (action == "skip") {
+        rule.action = MountAction::Skip;
+    } else if (action == "names_only") {
+        rule.action = MountAction::NamesOnly;
+    } else if (action == "throttle") {
+        rule.action = MountAction::Throttle;
+    } else if (action == "scan") {
+        rule.action = MountAction::Scan;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool MountPolicies::rule_matches(const Rule& rule, const MountInfo& mount) {
+    const string& pattern = rule.pattern;
+    if (pattern[0] == '/') {
+        return trim_separator(pattern) == trim_separator(mount.mount_point);
+    }
+    if (pattern == "pseudo") {
+        return contains(kPseudoTypes, mount.fstype);
+    }
+    if (pattern == "network") {
+        return contains(kNetworkTypes, mount.fstype);
+    }
+    if (pattern.back() == '*') {
+        return mount.fstype.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+    }
+    return mount.fstype == pattern;
+}
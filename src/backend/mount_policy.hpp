@@ -0,0 +1,76 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 挂载点的处理方式
+enum class MountAction {
+    Scan,  // 正常扫描
+    Skip,  // 不进入：挂载点按空目录列出
+    NamesOnly,  // 只列名称和类型（同names_only），不stat
+    Throttle,  // 同一挂载点内同时只有一个线程读取目录（适用于慢速网络挂载）
+};
+
+// 扫描中遇到的、不按正常方式扫描的挂载点
+struct MountReport {
+    std::string path;  // 挂载点（扫描路径）
+    std::string fstype;
+    MountAction action;
+};
+
+// 挂载表的一项（/proc/self/mountinfo）
+struct MountInfo {
+    std::string mount_point;
+    std::string fstype;
+    std::string source;
+};
+
+// 挂载点策略：扫描开始时读取一次挂载表，按规则为根目录下的每个挂载点确定处理方式。
+// 目录按所在的（最深的）挂载点处理，挂载点按路径识别，因此同一文件系统的bind mount也能识别。
+//
+// 规则为 "匹配=动作"，动作为 skip / names_only / throttle：
+//   nfs4=throttle          按文件系统类型匹配，以 * 结尾时按前缀匹配（fuse.*）
+//   /mnt/backup=skip       以 / 开头：按挂载点路径匹配
+//   pseudo=skip            proc、sysfs、cgroup等伪文件系统
+//   network=throttle       nfs、cifs、sshfs等网络文件系统
+// 挂载表只在Linux上可用，其他平台上规则不起作用
+class MountPolicies {
+public:
+    struct Mount {
+        std::string path;  // 扫描路径下的挂载点（'/'分隔，与列出的目录路径一致）
+        std::string fstype;
+        MountAction action;
+        std::shared_ptr<std::mutex> throttle;  // Throttle时读取目录前加锁
+    };
+
+    MountPolicies() = default;
+
+    // root: 扫描根目录；one_filesystem时根目录下的所有挂载点都跳过（规则不再起作用）
+    MountPolicies(const std::vector<std::string>& rules, bool one_filesystem, const std::string& root);
+
+    // 没有需要特殊处理的挂载点（调用方不必逐个目录查找）
+    bool empty() const { return mounts_.empty(); }
+
+    // 目录所在的有规则的挂载点（最长前缀），正常扫描时返回nullptr
+    const Mount* find(const std::filesystem::path& dir) const;
+
+    // 读取本进程的挂载表（非Linux或读取失败时为空）
+    static std::vector<MountInfo> read_mount_table();
+
+    static const char* action_name(MountAction action);
+
+private:
+    struct Rule {
+        std::string pattern;
+        MountAction action;
+    };
+
+    static bool parse_rule(const std::string& text, Rule& rule);
+    static bool rule_matches(const Rule& rule, const MountInfo& mount);
+
+    std::vector<Mount> mounts_;  // 按路径从长到短排列，第一个匹配的即为最深的挂载点
+};
@@ -0,0 +1,151 @@
+#include "parallel_scanner.hpp"
+#include "scan_visitor.hpp"
+#include "thread_pool.hpp"
+#include <iostream>
+
+using namespace std;
+
+SubtreeTotals ParallelScanner::scan(const fs::path& root, 
+                                    ScanVisitor& visitor, 
+                                    ScanContext& ctx,
+                                    ScanStats& stats) {
+    // 节点与同步状态须比线程池活得更久：线程池析构时会执行完剩余任务
+    State state;
+    Node root_node;
+    SubtreeTotals totals;
+    
+    {
+        WorkStealingPool pool(static_cast<size_t>(ctx.options.threads));
+        pool.submit([&pool, &state, &root_node, &root, &ctx]() {
+            scan_node(pool, state, &root_node, root, ctx, 0, nullptr, nullptr);
+        });
+        try {
+            totals = emit(state, root_node, visitor, ctx, stats);
+        } catch (...) {
+            // 访问者抛出异常：让剩下的任务尽快结束，线程池析构时等待它们
+            state.failed = true;
+            throw;
+        }
+        pool.wait_idle();
+    }
+    
+    if (state.error) {
+        rethrow_exception(state.error);
+    }
+    return totals;
+}
+
+void ParallelScanner::scan_node(WorkStealingPool& pool, 
+                                State& state,
+                                Node* node, 
+                                const fs::path& path, 
+                                ScanContext& ctx,
+                                int depth,
+                                shared_ptr<DirHandle> parent,
+                                shared_ptr<DirHandle> opened) {
+    // 无论如何都要标记节点已就绪，否则调用线程会一直等待
+    if (state.failed) {
+        mark_ready(state, node);
+        return;
+    }
+    try {
+        node->listing = FileSystemScanner::list_directory(path, ctx, depth, parent, std::move(opened));
+        parent.reset();
+        
+        // 先分配好所有子节点，任务只写自己的节点，无需加锁
+        auto& subdirs = node->listing.subdirs;
+        node->children.resize(subdirs.size());
+        for (auto& child : node->children) {
+            child = make_unique<Node>();
+        }
+        
+        // 子任务各持有一份目录句柄，最后一个子目录打开后即关闭
+        shared_ptr<DirHandle> handle = std::move(node->listing.handle);
+        for (size_t i = 0; i < subdirs.size(); i++) {
+            Node* child = node->children[i].get();
+            if (!subdirs[i].descend) {
+                // 不进入的目录：空节点，本节点就绪前无人读取，无需加锁
+                child->ready = true;
+                continue;
+            }
+            const fs::path* child_path = &subdirs[i].path;
+            shared_ptr<DirHandle> opened = std::move(subdirs[i].handle);
+            pool.submit([&pool, &state, child, child_path, &ctx, depth, handle, opened]() {
+                scan_node(pool, state, child, *child_path, ctx, depth + 1, handle, opened);
+            });
+        }
+    } catch (const fs::filesystem_error& e) {
+        cerr << "Error accessing " << path << ": " << e.what() << endl;
+    } catch (...) {
+        // 内存不足、线程创建失败或排除规则等抛出的异常：整个扫描失败
+        fail(state, current_exception());
+    }
+    
+    mark_ready(state, node);
+}
+
+void ParallelScanner::fail(State& state, exception_ptr error) {
+    {
+        lock_guard<mutex> lock(state.mutex);
+        if (!state.error) {
+            state.error = std::move(error);
+        }
+        state.failed = true;
+    }
+    state.ready_cv.notify_all();
+}
+
+void ParallelScanner::mark_ready(State& state, Node* node) {
+    bool notify;
+    {
+        lock_guard<mutex> lock(state.mutex);
+        node->ready = true;
+        notify = state.waiting_for == node;
+    }
+    if (notify) {
+        state.ready_cv.notify_one();
+    }
+}
+
+bool ParallelScanner::wait_ready(State& state, const Node* node) {
+    unique_lock<mutex> lock(state.mutex);
+    state.waiting_for = node;
+    state.ready_cv.wait(lock, [&state, node]() { return node->ready || state.error; });
+    state.waiting_for = nullptr;
+    return !state.error;
+}
+
+SubtreeTotals ParallelScanner::emit(State& state,
+                                    Node& node, 
+                                    ScanVisitor& visitor, 
+                                    ScanContext& ctx,
+                                    ScanStats& stats) {
+    SubtreeTotals totals;
+    if (!wait_ready(state, &node)) {
+        return totals;
+    }
+    
+    stats.pruned.add(node.listing.pruned);
+    totals.add(node.listing.pruned);
+    
+    const auto& subdirs = node.listing.subdirs;
+    for (size_t i = 0; i < subdirs.size(); i++) {
+        visitor.enter_directory(subdirs[i].info);
+        SubtreeTotals child = emit(state, *node.children[i], visitor, ctx, stats);
+        if (state.failed) {
+            return totals;  // 扫描失败，结果在scan中丢弃
+        }
+        visitor.leave_directory(subdirs[i].info, child);
+        child.dir_count += 1;
+        totals.add(child);
+        node.children[i].reset();  // 尽早释放已发出的子树
+    }
+    
+    FileSystemScanner::count_omitted_links(ctx, stats, node.listing);
+    for (const auto& info : node.listing.files) {
+        FileSystemScanner::count_file(ctx, stats, totals, info);
+        visitor.file(info);
+    }
+    
+    return totals;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+class WorkStealingPool;
+
+// 并行扫描引擎：子目录作为任务交给工作窃取线程池，
+// 每个目录的读取结果挂在一棵临时树上。调用线程同时按
+// 与串行扫描完全相同的顺序（目录优先、按名称排序的DFS）
+// 等待下一个目录读取完成并发出事件，已发出的子树立即释放
+class ParallelScanner {
+public:
+    static SubtreeTotals scan(const fs::path& root, 
+                              ScanVisitor& visitor, 
+                              ScanContext& ctx,
+                              ScanStats& stats);
+    
+private:
+    struct Node {
+        DirListing listing;
+        std::vector<std::unique_ptr<Node>> children;  // 与listing.subdirs一一对应
+        bool ready = false;  // listing与children已填好（受State::mutex保护）
+    };
+    
+    // 工作线程与发出事件的调用线程之间的同步
+    struct State {
+        std::mutex mutex;
+        std::condition_variable ready_cv;
+        const Node* waiting_for = nullptr;  // 调用线程正在等待的节点
+        std::exception_ptr error;  // 第一个意外的异常（受mutex保护），扫描结束后在调用线程重新抛出
+        std::atomic<bool> failed{false};  // 已有异常：工作线程不再读取目录，调用线程不再等待
+    };
+    
+    // 读取一个目录，并把其子目录作为新任务提交
+    static void scan_node(WorkStealingPool& pool, 
+                          State& state,
+                          Node* node, 
+                          const fs::path& path, 
+                          ScanContext& ctx,
+                          int depth,
+                          std::shared_ptr<DirHandle> parent,
+                          std::shared_ptr<DirHandle> opened);
+    
+    static void mark_ready(State& state, Node* node);
+    // 等到节点读取完成；扫描已失败时返回false
+    static bool wait_ready(State& state, const Node* node);
+    // 记下异常并唤醒调用线程
+    static void fail(State& state, std::exception_ptr error);
+    
+    // 按DFS顺序发出事件，同时自底向上累计子树汇总
+    static SubtreeTotals emit(State& state,
+                              Node& node, 
+                              ScanVisitor& visitor, 
+                              ScanContext& ctx,
+                              ScanStats& stats);
+};
@@ -0,0 +1,266 @@
+#include "response_compression.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr size_t kOutputBufferSize = 64 * 1024;
+
+string_view trim(string_view text) {
+    const size_t first = text.find_first_not_of(" \t");
+    if (first == string_view::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+bool equals_ignore_case(string_view a, string_view b) {
+    return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return (x >= 'A' && x <= 'Z' ? x - 'A' + 'a' : x) == (y >= 'A' && y <= 'Z' ? y - 'A' + 'a' : y);
+    });
+}
+
+class IdentityCompressor final : public ResponseCompressor {
+public:
+    explicit IdentityCompressor(Output output) : ResponseCompressor(std::move(output)) {}
+
+protected:
+    bool process(string_view input, bool last) override {
+        return input.empty() || emit(input.data(), input.size());
+    }
+};
+
+#ifdef HAVE_ZLIB
+class GzipCompressor final : public ResponseCompressor {
+public:
+    GzipCompressor(int level, Output output) : ResponseCompressor(std::move(output)) {
+        // windowBits加16：写出gzip头和尾（而不是zlib格式）
+        valid_ = deflateInit2(&stream_, max(1, min(level, 9)), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~GzipCompressor() override {
+        if (valid_) {
+            deflateEnd(&stream_);
+        }
+    }
+
+protected:
+    bool process(string_view input, bool last) override {
+        if (!valid_) {
+            return false;
+        }
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream_.avail_in = static_cast<uInt>(input.size());
+        const int flush = last ? Z_FINISH : Z_NO_FLUSH;
+        int result;
+        do {
+            stream_.next_out = reinterpret_cast<Bytef*>(buffer_);
+            stream_.avail_out = sizeof(buffer_);
+            result = deflate(&stream_, flush);
+            if (result == Z_STREAM_ERROR) {
+                return false;
+            }
+            const size_t produced = sizeof(buffer_) - stream_.avail_out;
+            if (produced > 0 && !emit(buffer_, produced)) {
+                return false;
+            }
+        } while (stream_.avail_out == 0 || (last && result != Z_STREAM_END));
+        return true;
+    }
+
+private:
+    z_stream stream_{};
+    bool valid_ = false;
+    char buffer_[kOutputBufferSize];
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ZstdCompressor final : public ResponseCompressor {
+public:
+    ZstdCompressor(int level, Output output)
+        : ResponseCompressor(std::move(output)), context_(ZSTD_createCCtx()) {
+        if (context_) {
+            ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, max(1, min(level, ZSTD_maxCLevel())));
+        }
+    }
+
+    ~ZstdCompressor() override { ZSTD_freeCCtx(context_); }
+
+protected:
+    bool process(string_view input, bool last) override {
+        if (!context_) {
+            return false;
+        }
+        ZSTD_inBuffer in = {input.data(), input.size(), 0};
+        const ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = {buffer_, sizeof(buffer_), 0};
+            remaining = ZSTD_compressStream2(context_, &out, &in, mode);
+            if (ZSTD_isError(remaining)) {
+                return false;
+            }
+            if (out.pos > 0 && !emit(buffer_, out.pos)) {
+                return false;
+            }
+        } while (last ? remaining != 0 : in.pos < in.size);
+        return true;
+    }
+
+private:
+    ZSTD_CCtx* context_;
+    char buffer_[kOutputBufferSize];
+};
+#endif
+
+}
+
+ContentEncoding negotiate_encoding(string_view accept_encoding, const CompressionSettings& settings) {
+    // 每项形如"gzip;q=0.8"，没有q时为1；"*"代表没有单独列出的编码
+    double gzip_q = -1;
+    double zstd_q = -1;
+    double any_q = -1;
+    while (!accept_encoding.empty()) {
+        const size_t comma = accept_encoding.find(',');
+        string_view item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == string_view::npos ? string_view() : accept_encoding.substr(comma + 1);
+
+        const size_t semicolon = item.find(';');
+        const string_view name = trim(item.substr(0, semicolon));
+        double q = 1;
+        if (semicolon != string_view::npos) {
+            const string_view parameter = trim(item.substr(semicolon + 1));
+            if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=') {
+                q = strtod(string(parameter.substr(2)).c_str(), nullptr);
+            }
+        }
+
+        if (equals_ignore_case(name, "gzip") || equals_ignore_case(name, "x-gzip")) {
+            gzip_q = q;
+        } else if (equals_ignore_case(name, "zstd")) {
+            zstd_q = q;
+        } else if (name == "*") {
+            any_q = q;
+        }
+    }
+    if (gzip_q < 0) {
+        gzip_q = any_q;
+    }
+    if (zstd_q < 0) {
+        zstd_q = any_q;
+    }
+
+#ifndef HAVE_ZLIB
+    gzip_q = 0;
+#endif
+#ifndef HAVE_ZSTD
+    zstd_q = 0;
+#endif
+    if (settings.gzip_level <= 0) {
+        gzip_q = 0;
+    }
+    if (settings.zstd_level <= 0) {
+        zstd_q = 0;
+    }
+
+    if (zstd_q > 0 && zstd_q >= gzip_q) {
+        return ContentEncoding::Zstd;
+    }
+    if (gzip_q > 0) {
+        return ContentEncoding::Gzip;
+    }
+    return ContentEncoding::Identity;
+}
+
+const char* content_encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Zstd: return "zstd";
+        case ContentEncoding::Identity: break;
+    }
+    return nullptr;
+}
+
+bool is_compressible_type(string_view content_type) {
+    const string_view type = trim(content_type.substr(0, content_type.find(';')));
+    return type.compare(0, 5, "text/") == 0 ||
+           type == "application/json" ||
+           type == "application/x-ndjson" ||
+           type == "application/javascript" ||
+           type == "application/xml" ||
+           type == "image/svg+xml";
+}
+
+unique_ptr<ResponseCompressor> ResponseCompressor::create(ContentEncoding encoding,
+                                                          const CompressionSettings& settings,
+                                                          Output output) {
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case ContentEncoding::Gzip:
+            return make_unique<GzipCompressor>(settings.gzip_level, std::move(output));
+#endif
+#ifdef HAVE_ZSTD
+        case ContentEncoding::Zstd:
+            return make_unique<ZstdCompressor>(settings.zstd_level, std::move(output));
+#endif
+        default:
+            break;
+    }
+    return make_unique<IdentityCompressor>(std::move(output));
+}
+
+bool ResponseCompressor::write(string_view data) {
+    if (failed_) {
+        return false;
+    }
+    // 攒够一块再交给压缩器：树的文本本来就分块输出，扫描结果则是逐个条目的小段
+    if (pending_.size() + data.size() < kChunkSize) {
+        pending_.append(data);
+        return true;
+    }
+    if (!pending_.empty()) {
+        pending_.append(data);
+        data = pending_;
+    }
+    failed_ = !process(data, false);
+    pending_.clear();
+    return !failed_;
+}
+
+bool ResponseCompressor::finish() {
+    if (failed_) {
+        return false;
+    }
+    failed_ = !process(pending_, true);
+    pending_.clear();
+    return !failed_;
+}
+
+bool ResponseCompressor::emit(const char* data, size_t length) {
+    if (!output_(data, length)) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+string compress_string(string_view data, ContentEncoding encoding, const CompressionSettings& settings) {
+    string compressed;
+    auto compressor = ResponseCompressor::create(encoding, settings, [&compressed](const char* chunk, size_t length) {
+        compressed.append(chunk, length);
+        return true;
+    });
+    compressor->write(data);
+    compressor->finish();
+    return compressed;
+}
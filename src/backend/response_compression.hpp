@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// HTTP响应压缩：按Accept-Encoding选择gzip（zlib）或zstd，流式压缩，
+// 压缩后的数据分块交给调用方。编译时没有zlib/zstd（HAVE_ZLIB/HAVE_ZSTD）的编码不会被选中
+
+enum class ContentEncoding {
+    Identity,  // 不压缩
+    Gzip,
+    Zstd,
+};
+
+struct CompressionSettings {
+    int gzip_level = 6;  // 1-9，0表示不使用gzip
+    int zstd_level = 3;  // 1-19，0表示不使用zstd
+    size_t min_size = 1024;  // 小于此大小（字节）的响应不压缩
+};
+
+// 在客户端接受（q > 0）且已启用的编码中选择q最大的，相同时zstd优先（同样的体积压缩更快）
+ContentEncoding negotiate_encoding(std::string_view accept_encoding, const CompressionSettings& settings);
+
+// Content-Encoding头的值，Identity为nullptr
+const char* content_encoding_name(ContentEncoding encoding);
+
+// 内容类型是否值得压缩（文本、JSON、JavaScript等）
+bool is_compressible_type(std::string_view content_type);
+
+// 流式压缩：write的数据先攒够一块再压缩，压缩后的数据交给output。
+// output返回false（接收方已断开）后不再压缩，write/finish也返回false
+class ResponseCompressor {
+public:
+    using Output = std::function<bool(const char* data, size_t length)>;
+
+    // Identity时原样分块输出
+    static std::unique_ptr<ResponseCompressor> create(ContentEncoding encoding,
+                                                      const CompressionSettings& settings,
+                                                      Output output);
+
+    virtual ~ResponseCompressor() = default;
+
+    bool write(std::string_view data);
+    // 压缩剩余的数据并结束压缩流
+    bool finish();
+
+protected:
+    explicit ResponseCompressor(Output output) : output_(std::move(output)) {}
+
+    // 压缩一块输入（last时结束压缩流），通过emit输出
+    virtual bool process(std::string_view input, bool last) = 0;
+    bool emit(const char* data, size_t length);
+
+private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    Output output_;
+    std::string pending_;
+    bool failed_ = false;
+};
+
+// 整段数据一次压缩
+std::string compress_string(std::string_view data, ContentEncoding encoding, const CompressionSettings& settings);
@@ -0,0 +1,305 @@
+#include "scan_result.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t ScanResult::add(const FileInfo& info, uint32_t parent) {
+    materialize();
+    if (parent_.size() >= kNoParent || names_.size() + info.name.size() >= UINT32_MAX) {
+        throw length_error("scan result exceeds 32-bit index range");
+    }
+
+    uint32_t index = static_cast<uint32_t>(parent_.size());
+    names_ += info.name;
+    name_offset_.push_back(static_cast<uint32_t>(names_.size()));
+    parent_.push_back(parent);
+    size_.push_back(info.size);
+    mtime_.push_back(info.last_modified.time_since_epoch().count());
+    depth_.push_back(static_cast<uint32_t>(info.depth));
+
+    uint8_t flags = 0;
+    if (info.is_directory) {
+        flags |= kDirectory;
+        // 目录按前序追加，dir_totals_天然按下标有序
+        dir_totals_.push_back({index, 0, info.file_count, info.dir_count});
+    } else if (info.omitted) {
+        flags |= kOmitted;
+        dir_totals_.push_back({index, index + 1, info.file_count, 0});
+    }
+    if (info.includes_pruned) {
+        flags |= kIncludesPruned;
+    }
+    if (info.last_in_directory) {
+        flags |= kLastInDirectory;
+    }
+    flags_.push_back(flags);
+
+    return index;
+}
+
+void ScanResult::set_totals(uint32_t index, const SubtreeTotals& totals) {
+    materialize();
+    size_[index] = totals.size;
+    if (totals.includes_pruned) {
+        flags_[index] |= kIncludesPruned;
+    } else {
+        flags_[index] &= ~kIncludesPruned;
+    }
+
+    if (const DirTotals* dir = find_dir(index)) {
+        DirTotals& target = dir_totals_[dir - dir_totals_.data()];
+        target.subtree_end = static_cast<uint32_t>(parent_.size());
+        target.file_count = totals.file_count;
+        target.dir_count = totals.dir_count;
+    }
+}
+
+void ScanResult::materialize() {
+    if (!mapped_) {
+        return;
+    }
+    const Mapped& m = *mapped_;
+    names_.assign(m.names, m.name_offsets[m.count]);
+    name_offset_.assign(m.name_offsets, m.name_offsets + m.count + 1);
+    parent_.assign(m.parents, m.parents + m.count);
+    size_.assign(m.sizes, m.sizes + m.count);
+    mtime_.assign(m.mtimes, m.mtimes + m.count);
+    depth_.assign(m.depths, m.depths + m.count);
+    flags_.assign(m.flags, m.flags + m.count);
+    dir_totals_.assign(m.dirs, m.dirs + m.dir_count);
+    mapped_.reset();
+}
+
+const ScanResult::DirTotals* ScanResult::find_dir(size_t i) const {
+    const DirTotals* end = dirs_end();
+    const DirTotals* it = lower_bound(dirs_begin(), end, i,
+                                      [](const DirTotals& dir, size_t index) { return dir.index < index; });
+    if (it == end || it->index != i) {
+        return nullptr;
+    }
+    return it;
+}
+
+uintmax_t ScanResult::file_count(size_t i) const {
+    const DirTotals* dir = find_dir(i);
+    return dir ? dir->file_count : 0;
+}
+
+uintmax_t ScanResult::dir_count(size_t i) const {
+    const DirTotals* dir = find_dir(i);
+    return dir ? dir->dir_count : 0;
+}
+
+size_t ScanResult::subtree_end(size_t i) const {
+    const DirTotals* dir = is_directory(i) ? find_dir(i) : nullptr;
+    if (!dir) {
+        return i + 1;
+    }
+    if (dir->subtree_end > i) {
+        return dir->subtree_end;
+    }
+    // 汇总未回填（扫描中途）：子孙是其后深度更大的连续条目
+    const uint32_t* depth = depths();
+    size_t end = i + 1;
+    while (end < size() && depth[end] > depth[i]) {
+        end++;
+    }
+    return end;
+}
+
+size_t ScanResult::find(string_view relative_path) const {
+#ifdef _WIN32
+    const string_view separators = "/\\";
+#else
+    const string_view separators = "/";
+#endif
+
+    size_t found = kNotFound;
+    size_t first = 0;  // 当前目录的第一个子项
+    size_t end = size();  // 当前目录子树的结束位置
+    size_t pos = 0;
+    while (pos < relative_path.size()) {
+        size_t next = relative_path.find_first_of(separators, pos);
+        if (next == string_view::npos) {
+            next = relative_path.size();
+        }
+        const string_view part = relative_path.substr(pos, next - pos);
+        pos = next + 1;
+        if (part.empty() || part == ".") {
+            continue;
+        }
+
+        size_t child = first;
+        while (child < end && name(child) != part) {
+            child = subtree_end(child);
+        }
+        if (child >= end) {
+            return kNotFound;
+        }
+        found = child;
+        first = child + 1;
+        end = subtree_end(child);
+    }
+    return found;
+}
+
+string ScanResult::path(size_t i) const {
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+
+    // 先沿父链算出总长度，再从尾部向前填入名称，只分配一次
+    bool root_has_separator = root_.empty() || root_.back() == '/' || root_.back() == separator;
+    size_t length = root_.size() + (root_has_separator ? 0 : 1);
+    const uint32_t* parent = parents();
+    const uint32_t* offset = name_offsets();
+    for (uint32_t cur = static_cast<uint32_t>(i); cur != kNoParent; cur = parent[cur]) {
+        length += offset[cur + 1] - offset[cur];
+        if (parent[cur] != kNoParent) {
+            length += 1;
+        }
+    }
+
+    string full(length, separator);
+    full.replace(0, root_.size(), root_);
+    size_t pos = length;
+    for (uint32_t cur = static_cast<uint32_t>(i); cur != kNoParent; cur = parent[cur]) {
+        string_view part = name(cur);
+        pos -= part.size();
+        full.replace(pos, part.size(), part.data(), part.size());
+        pos -= 1;  // 分隔符已预先填好
+    }
+    return full;
+}
+
+FileInfo ScanResult::info(size_t i) const {
+    FileInfo info;
+    info.name = string(name(i));
+    // 汇总条目没有名称，路径为所在目录
+    info.path = !omitted(i) ? path(i) : parent(i) == kNoParent ? root_ : path(parent(i));
+    info.is_directory = is_directory(i);
+    info.size = file_size(i);
+    info.last_modified = last_modified(i);
+    info.depth = depth(i);
+    info.includes_pruned = includes_pruned(i);
+    info.last_in_directory = last_in_directory(i);
+    info.omitted = omitted(i);
+    if (const DirTotals* dir = find_dir(i)) {
+        info.file_count = dir->file_count;
+        info.dir_count = dir->dir_count;
+    }
+    return info;
+}
+
+SubtreeTotals ScanResult::totals(size_t i) const {
+    SubtreeTotals totals;
+    totals.size = file_size(i);
+    totals.includes_pruned = includes_pruned(i);
+    if (const DirTotals* dir = find_dir(i)) {
+        totals.file_count = dir->file_count;
+        totals.dir_count = dir->dir_count;
+    }
+    return totals;
+}
+
+void ScanResult::replay(ScanVisitor& visitor) const {
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    
+    // 与path()结果相同，但所有条目共用一个路径缓冲：进入目录时追加名称，
+    // 打开的目录只记下自己的路径长度。每个条目不必沿父链重建，
+    // 很深的树也不必为每层保存一份完整路径
+    string path = root_;
+    if (!(root_.empty() || root_.back() == '/' || root_.back() == separator)) {
+        path += separator;
+    }
+    const size_t root_length = path.size();
+    
+    struct OpenDir {
+        uint32_t index;
+        size_t path_length;
+    };
+    vector<OpenDir> open_dirs;
+    FileInfo entry;  // 所有事件复用同一个FileInfo，名称和路径的空间不再重新分配
+    
+    auto fill = [&](size_t i, size_t path_length) {
+        entry.name.assign(name(i));
+        entry.path.assign(path, 0, path_length);
+        entry.is_directory = is_directory(i);
+        entry.size = file_size(i);
+        entry.last_modified = last_modified(i);
+        entry.depth = depth(i);
+        entry.includes_pruned = includes_pruned(i);
+        entry.last_in_directory = last_in_directory(i);
+        entry.omitted = omitted(i);
+        const DirTotals* dir = entry.is_directory || entry.omitted ? find_dir(i) : nullptr;
+        entry.file_count = dir ? dir->file_count : 0;
+        entry.dir_count = dir ? dir->dir_count : 0;
+    };
+    
+    auto leave = [&]() {
+        const OpenDir& dir = open_dirs.back();
+        fill(dir.index, dir.path_length);
+        visitor.leave_directory(entry, totals(dir.index));
+        open_dirs.pop_back();
+    };
+    
+    for (size_t i = 0; i < size(); i++) {
+        // 关闭不包含当前条目的目录
+        while (!open_dirs.empty() && open_dirs.back().index != parent(i)) {
+            leave();
+        }
+        
+        if (open_dirs.empty()) {
+            path.resize(root_length);
+        } else {
+            path.resize(open_dirs.back().path_length);
+            path += separator;
+        }
+        path += name(i);
+        
+        // 汇总条目没有名称，路径为所在目录
+        fill(i, omitted(i) ? (open_dirs.empty() ? root_.size() : open_dirs.back().path_length) : path.size());
+        if (entry.is_directory) {
+            visitor.enter_directory(entry);
+            open_dirs.push_back({static_cast<uint32_t>(i), path.size()});
+        } else {
+            visitor.file(entry);
+        }
+    }
+    
+    while (!open_dirs.empty()) {
+        leave();
+    }
+}
+
+size_t ScanResult::memory_usage() const {
+    return names_.capacity() +
+           name_offset_.capacity() * sizeof(uint32_t) +
+           parent_.capacity() * sizeof(uint32_t) +
+           size_.capacity() * sizeof(uint64_t) +
+           mtime_.capacity() * sizeof(fs::file_time_type::rep) +
+           depth_.capacity() * sizeof(uint32_t) +
+           flags_.capacity() * sizeof(uint8_t) +
+           dir_totals_.capacity() * sizeof(DirTotals);
+}
+
+void ScanResult::shrink_to_fit() {
+    if (mapped_) {
+        return;
+    }
+    names_.shrink_to_fit();
+    name_offset_.shrink_to_fit();
+    parent_.shrink_to_fit();
+    size_.shrink_to_fit();
+    mtime_.shrink_to_fit();
+    depth_.shrink_to_fit();
+    flags_.shrink_to_fit();
+    dir_totals_.shrink_to_fit();
+}
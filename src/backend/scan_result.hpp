@@ -0,0 +1,172 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "scan_visitor.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 紧凑的扫描结果：与vector<FileInfo>顺序相同（目录优先的DFS），但
+//   - 名称连续存放在一块arena中，不再为每个条目保存完整路径
+//   - 每个条目用32位下标指向父目录，完整路径按需重建
+//   - 大小、修改时间、深度和标志位分别存放在紧凑数组中
+//   - 子树计数只有目录（和汇总条目，见FileInfo::omitted）才有，单独存放
+//
+// 从快照文件加载的结果直接读取映射的内存（见SnapshotFile），第一次修改时才复制到数组中
+class ScanResult {
+    friend class SnapshotFile;
+
+public:
+    static constexpr uint32_t kNoParent = UINT32_MAX;  // 根目录的直接子项
+
+    explicit ScanResult(std::string root = std::string()) : root_(std::move(root)) {}
+
+    // 追加一个条目（info.path被忽略），返回其下标
+    uint32_t add(const FileInfo& info, uint32_t parent);
+
+    // 回填目录的子树汇总；在子树的所有条目追加之后调用，同时记下子树的结束位置
+    void set_totals(uint32_t index, const SubtreeTotals& totals);
+
+    void set_last_modified(uint32_t index, fs::file_time_type time) {
+        materialize();
+        mtime_[index] = time.time_since_epoch().count();
+    }
+
+    size_t size() const { return mapped_ ? mapped_->count : parent_.size(); }
+    bool empty() const { return size() == 0; }
+    const std::string& root() const { return root_; }
+
+    std::string_view name(size_t i) const {
+        const uint32_t* offset = name_offsets();
+        return std::string_view(name_data() + offset[i], offset[i + 1] - offset[i]);
+    }
+    uint32_t parent(size_t i) const { return parents()[i]; }
+    bool is_directory(size_t i) const { return (flag_data()[i] & kDirectory) != 0; }
+    bool includes_pruned(size_t i) const { return (flag_data()[i] & kIncludesPruned) != 0; }
+    bool last_in_directory(size_t i) const { return (flag_data()[i] & kLastInDirectory) != 0; }
+    bool omitted(size_t i) const { return (flag_data()[i] & kOmitted) != 0; }
+    int depth(size_t i) const { return static_cast<int>(depths()[i]); }
+    uintmax_t file_size(size_t i) const { return sizes()[i]; }
+    fs::file_time_type last_modified(size_t i) const {
+        return fs::file_time_type(fs::file_time_type::duration(mtimes()[i]));
+    }
+
+    // 目录子树中的文件数/子目录数（文件返回0，汇总条目的file_count为其代替的文件数）
+    uintmax_t file_count(size_t i) const;
+    uintmax_t dir_count(size_t i) const;
+
+    // 子树（条目i及其所有子孙）占据[i, subtree_end(i))，文件为i + 1。
+    // 同一目录的下一个兄弟条目即从subtree_end开始
+    size_t subtree_end(size_t i) const;
+
+    // 按相对根目录的路径（"a/b"）查找条目，找不到时（包括空路径，根目录不是条目）返回kNotFound。
+    // 沿路径逐层在兄弟条目间跳过整个子树，不逐个检查子孙
+    static constexpr size_t kNotFound = SIZE_MAX;
+    size_t find(std::string_view relative_path) const;
+
+    // 由父链重建完整路径
+    std::string path(size_t i) const;
+
+    // 还原为FileInfo
+    FileInfo info(size_t i) const;
+    
+    // 目录的子树汇总
+    SubtreeTotals totals(size_t i) const;
+    
+    // 按扫描时的顺序重放事件
+    void replay(ScanVisitor& visitor) const;
+
+    // 占用的堆内存（按容量计算）
+    size_t memory_usage() const;
+
+    // 扫描结束后释放多余容量
+    void shrink_to_fit();
+
+private:
+    enum : uint8_t {
+        kDirectory = 1 << 0,
+        kIncludesPruned = 1 << 1,
+        kLastInDirectory = 1 << 2,
+        kOmitted = 1 << 3,
+    };
+
+    // 布局固定，快照文件中的目录表与之相同
+    struct DirTotals {
+        uint32_t index;  // 目录或汇总条目的下标（按下标递增，可二分查找）
+        uint32_t subtree_end;  // 子树之后第一个条目的下标，未回填汇总时为0
+        uint64_t file_count;
+        uint64_t dir_count;
+    };
+
+    // 快照文件中各列的位置；keepalive持有映射
+    struct Mapped {
+        std::shared_ptr<const void> keepalive;
+        size_t count = 0;
+        size_t dir_count = 0;
+        const char* names = nullptr;
+        const uint32_t* name_offsets = nullptr;
+        const uint32_t* parents = nullptr;
+        const uint64_t* sizes = nullptr;
+        const fs::file_time_type::rep* mtimes = nullptr;
+        const uint32_t* depths = nullptr;
+        const uint8_t* flags = nullptr;
+        const DirTotals* dirs = nullptr;
+    };
+
+    const char* name_data() const { return mapped_ ? mapped_->names : names_.data(); }
+    const uint32_t* name_offsets() const { return mapped_ ? mapped_->name_offsets : name_offset_.data(); }
+    const uint32_t* parents() const { return mapped_ ? mapped_->parents : parent_.data(); }
+    const uint64_t* sizes() const { return mapped_ ? mapped_->sizes : size_.data(); }
+    const fs::file_time_type::rep* mtimes() const { return mapped_ ? mapped_->mtimes : mtime_.data(); }
+    const uint32_t* depths() const { return mapped_ ? mapped_->depths : depth_.data(); }
+    const uint8_t* flag_data() const { return mapped_ ? mapped_->flags : flags_.data(); }
+    const DirTotals* dirs_begin() const { return mapped_ ? mapped_->dirs : dir_totals_.data(); }
+    const DirTotals* dirs_end() const {
+        return mapped_ ? mapped_->dirs + mapped_->dir_count : dir_totals_.data() + dir_totals_.size();
+    }
+
+    // 把映射的数据复制到数组中（修改之前调用）
+    void materialize();
+
+    const DirTotals* find_dir(size_t i) const;
+
+    std::string root_;
+    std::shared_ptr<const Mapped> mapped_;  // 不为空时以下数组为空
+    std::string names_;  // 名称arena
+    std::vector<uint32_t> name_offset_{0};  // 第i个名称为[name_offset_[i], name_offset_[i + 1])
+    std::vector<uint32_t> parent_;
+    std::vector<uint64_t> size_;
+    std::vector<fs::file_time_type::rep> mtime_;
+    std::vector<uint32_t> depth_;
+    std::vector<uint8_t> flags_;
+    std::vector<DirTotals> dir_totals_;
+};
+
+// 扫描事件接收者：把扫描结果收集为ScanResult
+class ScanResultBuilder : public ScanVisitor {
+public:
+    explicit ScanResultBuilder(ScanResult& result) : result_(result) {}
+
+    void enter_directory(const FileInfo& dir) override {
+        open_dirs_.push_back(result_.add(dir, parent()));
+    }
+
+    void file(const FileInfo& file) override {
+        result_.add(file, parent());
+    }
+
+    void leave_directory(const FileInfo& dir, const SubtreeTotals& totals) override {
+        result_.set_totals(open_dirs_.back(), totals);
+        open_dirs_.pop_back();
+    }
+
+private:
+    uint32_t parent() const {
+        return open_dirs_.empty() ? ScanResult::kNoParent : open_dirs_.back();
+    }
+
+    ScanResult& result_;
+    std::vector<uint32_t> open_dirs_;
+};
@@ -0,0 +1,103 @@
+#include "scan_snapshot.hpp"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+bool DirStamp::read(const fs::path& path, DirStamp& stamp) {
+#ifdef _WIN32
+    // Windows上没有可移植的inode/ctime，只比较修改时间
+    error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    stamp = DirStamp();
+    stamp.mtime_ns = chrono::duration_cast<chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return true;
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    const struct timespec& mtime = st.st_mtimespec;
+    const struct timespec& ctime = st.st_ctimespec;
+#else
+    const struct timespec& mtime = st.st_mtim;
+    const struct timespec& ctime = st.st_ctim;
+#endif
+    stamp.device = static_cast<uint64_t>(st.st_dev);
+    stamp.inode = static_cast<uint64_t>(st.st_ino);
+    stamp.mtime_ns = static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+    stamp.ctime_ns = static_cast<int64_t>(ctime.tv_sec) * 1000000000 + ctime.tv_nsec;
+    return true;
+#endif
+}
+
+ScanSnapshot::ScanSnapshot(string root, const FileTreeOptions& options)
+    : result_(std::move(root)),
+      exclude_patterns_(options.exclude_patterns),
+      max_depth_(options.max_depth),
+      max_children_per_dir_(options.max_children_per_dir),
+      count_pruned_(options.count_pruned),
+      names_only_(options.names_only),
+      follow_symlinks_(options.follow_symlinks),
+      sort_order_(options.sort_order),
+      one_filesystem_(options.one_filesystem),
+      mount_policies_(options.mount_policies) {}
+
+ScanSnapshot::ScanSnapshot(ScanResult result, const FileTreeOptions& options)
+    : result_(std::move(result)),
+      exclude_patterns_(options.exclude_patterns),
+      max_depth_(options.max_depth),
+      max_children_per_dir_(options.max_children_per_dir),
+      count_pruned_(options.count_pruned),
+      names_only_(options.names_only),
+      follow_symlinks_(options.follow_symlinks),
+      sort_order_(options.sort_order),
+      one_filesystem_(options.one_filesystem),
+      mount_policies_(options.mount_policies) {}
+
+bool ScanSnapshot::compatible(const string& root, const FileTreeOptions& options) const {
+    return complete_ &&
+           root == result_.root() &&
+           options.exclude_patterns == exclude_patterns_ &&
+           options.max_depth == max_depth_ &&
+           options.max_children_per_dir == max_children_per_dir_ &&
+           options.count_pruned == count_pruned_ &&
+           options.names_only == names_only_ &&
+           options.follow_symlinks == follow_symlinks_ &&
+           options.sort_order == sort_order_ &&
+           options.one_filesystem == one_filesystem_ &&
+           options.mount_policies == mount_policies_ &&
+           !options.count_hardlinks_once;
+}
+
+void ScanSnapshot::add_record(uint32_t index, const DirStamp& stamp, const SubtreeTotals& pruned) {
+    if (index == ScanResult::kNoParent) {
+        root_record_ = {index, stamp, pruned};
+        has_root_record_ = true;
+        return;
+    }
+    records_.push_back({index, stamp, pruned});
+}
+
+const ScanSnapshot::DirRecord* ScanSnapshot::find_record(uint32_t index) const {
+    if (index == ScanResult::kNoParent) {
+        return has_root_record_ ? &root_record_ : nullptr;
+    }
+    auto it = lower_bound(records_.begin(), records_.end(), index,
+                          [](const DirRecord& record, uint32_t i) { return record.index < i; });
+    if (it == records_.end() || it->index != index) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+size_t ScanSnapshot::memory_usage() const {
+    return result_.memory_usage() + records_.capacity() * sizeof(DirRecord);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "scan_result.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 目录的变化标识：增删、重命名目录项会更新目录的mtime/ctime，
+// 目录被替换（删除后重建、挂载）则设备号或inode改变
+struct DirStamp {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t mtime_ns = 0;
+    int64_t ctime_ns = 0;
+
+    bool operator==(const DirStamp& other) const {
+        return device == other.device && inode == other.inode &&
+               mtime_ns == other.mtime_ns && ctime_ns == other.ctime_ns;
+    }
+
+    // 读取目录的标识（跟随符号链接），失败返回false
+    static bool read(const fs::path& path, DirStamp& stamp);
+};
+
+// 一次扫描的快照：扫描结果加上每个目录读取时的标识和被裁剪汇总，
+// 供下一次增量扫描（FileSystemScanner::rescan_directory）复用未变化的目录
+//
+// 目录的mtime只反映其直接目录项的增删改名：原地修改的文件大小、
+// 被裁剪子树内部的变化，在所在目录未变化时不会被发现
+class ScanSnapshot {
+    friend class FileSystemScanner;
+    friend class SnapshotFile;
+
+public:
+    ScanSnapshot(std::string root, const FileTreeOptions& options);
+
+    // 包装一次普通扫描的结果：没有目录标识，不能作为增量扫描的基础
+    ScanSnapshot(ScanResult result, const FileTreeOptions& options);
+
+    const ScanResult& result() const { return result_; }
+    const std::string& root() const { return result_.root(); }
+
+    // 是否为完整扫描（提前结束的扫描不能作为增量扫描的基础）
+    bool complete() const { return complete_; }
+
+    // 是否可以作为这次扫描的基础：完整扫描、根目录相同，且影响列出内容的选项相同。
+    // count_hardlinks_once需要每个文件的inode，复用的目录没有，总是完整扫描
+    bool compatible(const std::string& root, const FileTreeOptions& options) const;
+
+    // 占用的堆内存（按容量计算）
+    size_t memory_usage() const;
+
+private:
+    // 一个已读取目录的记录。index为条目下标，根目录为ScanResult::kNoParent
+    struct DirRecord {
+        uint32_t index;
+        DirStamp stamp;
+        SubtreeTotals pruned;
+    };
+
+    // 目录按前序读取，记录天然按下标有序
+    void add_record(uint32_t index, const DirStamp& stamp, const SubtreeTotals& pruned);
+    const DirRecord* find_record(uint32_t index) const;
+
+    ScanResult result_;
+    std::vector<DirRecord> records_;
+    DirRecord root_record_{ScanResult::kNoParent, {}, {}};
+    bool has_root_record_ = false;
+    bool complete_ = false;
+
+    // 影响列出内容的选项
+    std::vector<std::string> exclude_patterns_;
+    int max_depth_;
+    uint32_t max_children_per_dir_;
+    bool count_pruned_;
+    bool names_only_;
+    bool follow_symlinks_;
+    SortOrder sort_order_;  // 复用的目录保持原来的条目顺序
+    bool one_filesystem_;
+    std::vector<std::string> mount_policies_;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+// 扫描事件接收者：扫描过程中按输出顺序（目录优先、按options.sort_order排序的DFS）依次收到
+//   enter_directory(dir)          进入目录（扫描时dir的size/计数尚未汇总，以leave_directory为准）
+//   file(file)                    目录中的文件（在该目录的所有子目录之后）
+//   leave_directory(dir, totals)  离开目录，totals为该目录子树的汇总
+// 事件只在调用扫描的线程中发出（并行扫描时也是），传入的引用只在回调期间有效
+class ScanVisitor {
+public:
+    virtual ~ScanVisitor() = default;
+
+    virtual void enter_directory(const FileInfo& /*dir*/) {}
+    virtual void file(const FileInfo& /*file*/) {}
+    virtual void leave_directory(const FileInfo& /*dir*/, const SubtreeTotals& /*totals*/) {}
+};
+
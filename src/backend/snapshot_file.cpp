@@ -0,0 +1,555 @@
+#include "snapshot_file.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'M', 'S', 'N', 'A', 'P', '\r', '\n'};
+constexpr uint32_t kVersion = 6;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+enum Section {
+    kStrings,
+    kNames,
+    kNameOffsets,
+    kParents,
+    kSizes,
+    kMtimes,
+    kDepths,
+    kFlags,
+    kDirs,
+    kRecords,
+    kSectionCount,
+};
+
+enum : uint32_t {
+    kComplete = 1 << 0,
+    kShowSize = 1 << 1,
+    kHumanReadable = 1 << 2,
+    kCountPruned = 1 << 3,
+    kNamesOnly = 1 << 4,
+    kFollowSymlinks = 1 << 5,
+    kCountHardlinksOnce = 1 << 6,
+    kOneFilesystem = 1 << 7,
+    kSiUnits = 1 << 12,
+};
+
+// 条目顺序（SortOrder）存放在flags的这几位，旧文件为0即按名称
+constexpr uint32_t kSortOrderShift = 8;
+constexpr uint32_t kSortOrderMask = 0xF;
+
+// 人类可读大小的小数位数加1存放在这几位，0（旧文件）为默认的2位
+constexpr uint32_t kSizePrecisionShift = 13;
+constexpr uint32_t kSizePrecisionMask = 0x7;
+
+struct SectionRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t checksum;  // 头部之后全部内容的校验和
+    uint64_t entry_count;
+    uint64_t dir_count;
+    uint64_t record_count;  // 目录标识的个数（含根目录）
+    uint32_t flags;
+    int32_t max_depth;
+    uint32_t max_children_per_dir;
+    uint32_t reserved;
+    SectionRange sections[kSectionCount];
+};
+
+// 目录标识段的一项，index为ScanResult::kNoParent时是根目录
+struct DiskRecord {
+    uint32_t index;
+    uint32_t includes_pruned;
+    uint64_t device;
+    uint64_t inode;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    uint64_t pruned_size;
+    uint64_t pruned_files;
+    uint64_t pruned_dirs;
+};
+
+constexpr uint64_t align8(uint64_t value) {
+    return (value + 7) & ~uint64_t(7);
+}
+
+// 64位校验和：4路并行、每次8字节（xxHash64的轮函数），校验不会成为加载的瓶颈
+class Checksum {
+public:
+    void update(const void* data, size_t length) {
+        const char* p = static_cast<const char*>(data);
+        total_ += length;
+        if (pending_size_ > 0) {
+            size_t take = min(length, sizeof(pending_) - pending_size_);
+            memcpy(pending_ + pending_size_, p, take);
+            pending_size_ += take;
+            p += take;
+            length -= take;
+            if (pending_size_ < sizeof(pending_)) {
+                return;
+            }
+            stripe(pending_);
+            pending_size_ = 0;
+        }
+        for (; length >= sizeof(pending_); p += sizeof(pending_), length -= sizeof(pending_)) {
+            stripe(p);
+        }
+        memcpy(pending_, p, length);
+        pending_size_ = length;
+    }
+
+    uint64_t finish() const {
+        uint64_t h = rotl(lanes_[0], 1) + rotl(lanes_[1], 7) + rotl(lanes_[2], 12) + rotl(lanes_[3], 18);
+        h += total_;
+        size_t i = 0;
+        for (; i + 8 <= pending_size_; i += 8) {
+            h ^= round(0, load64(pending_ + i));
+            h = rotl(h, 27) * kPrime1 + kPrime4;
+        }
+        for (; i < pending_size_; i++) {
+            h ^= static_cast<uint8_t>(pending_[i]) * kPrime5;
+            h = rotl(h, 11) * kPrime1;
+        }
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static uint64_t load64(const char* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t lane) {
+        return rotl(acc + lane * kPrime2, 31) * kPrime1;
+    }
+
+    void stripe(const char* p) {
+        for (int i = 0; i < 4; i++) {
+            lanes_[i] = round(lanes_[i], load64(p + 8 * i));
+        }
+    }
+
+    uint64_t lanes_[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+    uint64_t total_ = 0;
+    char pending_[32];
+    size_t pending_size_ = 0;
+};
+
+void append_string(string& out, const string& value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out += value;
+}
+
+// 从字符串表中依次读取，越界时返回false
+class StringReader {
+public:
+    StringReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool read_u32(uint32_t& value) {
+        if (size_ - pos_ < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, data_ + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return true;
+    }
+
+    bool read_string(string& value) {
+        uint32_t length;
+        if (!read_u32(length) || size_ - pos_ < length) {
+            return false;
+        }
+        value.assign(data_ + pos_, length);
+        pos_ += length;
+        return true;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+// 只读映射整个文件，返回的指针在keepalive释放前有效
+const char* map_file(const fs::path& file, size_t& size, shared_ptr<const void>& keepalive) {
+#ifdef _WIN32
+    // Windows上读入内存
+    ifstream in(file, ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+    auto buffer = make_shared<string>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    size = buffer->size();
+    keepalive = buffer;
+    return buffer->data();
+#else
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    size = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    keepalive = shared_ptr<const void>(addr, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+    return static_cast<const char*>(addr);
+#endif
+}
+
+}  // namespace
+
+bool SnapshotFile::write(const fs::path& file, const ScanSnapshot& snapshot, const FileTreeOptions& options) {
+    static_assert(sizeof(fs::file_time_type::rep) == sizeof(int64_t), "mtime column is 64-bit");
+    static_assert(sizeof(ScanResult::DirTotals) == 24, "directory table layout");
+
+    const ScanResult& result = snapshot.result();
+    const size_t count = result.size();
+    const size_t dir_count = result.dirs_end() - result.dirs_begin();
+
+    string strings;
+    append_string(strings, result.root());
+    uint32_t pattern_count = static_cast<uint32_t>(options.exclude_patterns.size());
+    strings.append(reinterpret_cast<const char*>(&pattern_count), sizeof(pattern_count));
+    for (const string& pattern : options.exclude_patterns) {
+        append_string(strings, pattern);
+    }
+    uint32_t policy_count = static_cast<uint32_t>(options.mount_policies.size());
+    strings.append(reinterpret_cast<const char*>(&policy_count), sizeof(policy_count));
+    for (const string& policy : options.mount_policies) {
+        append_string(strings, policy);
+    }
+
+    vector<DiskRecord> records;
+    records.reserve(snapshot.records_.size() + 1);
+    auto add_record = [&](const ScanSnapshot::DirRecord& record) {
+        records.push_back({record.index, record.pruned.includes_pruned ? 1u : 0u,
+                           record.stamp.device, record.stamp.inode, record.stamp.mtime_ns, record.stamp.ctime_ns,
+                           record.pruned.size, record.pruned.file_count, record.pruned.dir_count});
+    };
+    if (snapshot.has_root_record_) {
+        add_record(snapshot.root_record_);
+    }
+    for (const auto& record : snapshot.records_) {
+        add_record(record);
+    }
+
+    const void* data[kSectionCount] = {
+        strings.data(),
+        result.name_data(),
+        result.name_offsets(),
+        result.parents(),
+        result.sizes(),
+        result.mtimes(),
+        result.depths(),
+        result.flag_data(),
+        result.dirs_begin(),
+        records.data(),
+    };
+    const uint64_t sizes[kSectionCount] = {
+        strings.size(),
+        result.name_offsets()[count],
+        (count + 1) * sizeof(uint32_t),
+        count * sizeof(uint32_t),
+        count * sizeof(uint64_t),
+        count * sizeof(int64_t),
+        count * sizeof(uint32_t),
+        count * sizeof(uint8_t),
+        dir_count * sizeof(ScanResult::DirTotals),
+        records.size() * sizeof(DiskRecord),
+    };
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    header.entry_count = count;
+    header.dir_count = dir_count;
+    header.record_count = records.size();
+    header.flags = (snapshot.complete() ? kComplete : 0) |
+                   (options.show_size ? kShowSize : 0) |
+                   (options.human_readable ? kHumanReadable : 0) |
+                   (options.count_pruned ? kCountPruned : 0) |
+                   (options.names_only ? kNamesOnly : 0) |
+                   (options.follow_symlinks ? kFollowSymlinks : 0) |
+                   (options.count_hardlinks_once ? kCountHardlinksOnce : 0) |
+                   (options.one_filesystem ? kOneFilesystem : 0) |
+                   (options.size_units == SizeUnits::SI ? kSiUnits : 0) |
+                   (static_cast<uint32_t>(options.size_precision + 1) << kSizePrecisionShift) |
+                   (static_cast<uint32_t>(options.sort_order) << kSortOrderShift);
+    header.max_depth = options.max_depth;
+    header.max_children_per_dir = options.max_children_per_dir;
+
+    uint64_t offset = align8(sizeof(Header));
+    for (int i = 0; i < kSectionCount; i++) {
+        header.sections[i] = {offset, sizes[i]};
+        offset = align8(offset + sizes[i]);
+    }
+    header.file_size = offset;
+
+    fs::path temp = file;
+    temp += ".tmp";
+    {
+        ofstream out(temp, ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "Failed to create snapshot file: " << temp.string() << endl;
+            return false;
+        }
+
+        static const char padding[8] = {};
+        Checksum checksum;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding, align8(sizeof(Header)) - sizeof(Header));
+        for (int i = 0; i < kSectionCount; i++) {
+            out.write(static_cast<const char*>(data[i]), sizes[i]);
+            checksum.update(data[i], sizes[i]);
+            size_t pad = align8(sizes[i]) - sizes[i];
+            out.write(padding, pad);
+            checksum.update(padding, pad);
+        }
+
+        header.checksum = checksum.finish();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out) {
+            cerr << "Failed to write snapshot file: " << temp.string() << endl;
+            error_code ec;
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+
+#ifndef _WIN32
+    // 改名之前落盘，崩溃后不会留下内容不完整的新文件
+    int fd = ::open(temp.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+
+    error_code ec;
+    fs::rename(temp, file, ec);
+    if (ec) {
+        cerr << "Failed to replace snapshot file " << file.string() << ": " << ec.message() << endl;
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+shared_ptr<const ScanSnapshot> SnapshotFile::load(const fs::path& file, FileTreeOptions* options) {
+    size_t size = 0;
+    shared_ptr<const void> keepalive;
+    const char* base = map_file(file, size, keepalive);
+    if (!base) {
+        return nullptr;
+    }
+
+    auto reject = [&](const char* reason) -> shared_ptr<const ScanSnapshot> {
+        cerr << "Ignoring snapshot file " << file.string() << ": " << reason << endl;
+        return nullptr;
+    };
+
+    if (size < sizeof(Header)) {
+        return reject("truncated");
+    }
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        return reject("not a snapshot file");
+    }
+    if (header.version != kVersion) {
+        return reject("unsupported version");
+    }
+    if (header.byte_order != kByteOrderMark) {
+        return reject("written on a machine with different byte order");
+    }
+    if (header.file_size != size) {
+        return reject("truncated");
+    }
+
+    const uint64_t count = header.entry_count;
+    if (count >= ScanResult::kNoParent) {
+        return reject("corrupt header");
+    }
+    const uint64_t expected[kSectionCount] = {
+        header.sections[kStrings].size,
+        header.sections[kNames].size,
+        (count + 1) * sizeof(uint32_t),
+        count * sizeof(uint32_t),
+        count * sizeof(uint64_t),
+        count * sizeof(int64_t),
+        count * sizeof(uint32_t),
+        count * sizeof(uint8_t),
+        header.dir_count * sizeof(ScanResult::DirTotals),
+        header.record_count * sizeof(DiskRecord),
+    };
+    for (int i = 0; i < kSectionCount; i++) {
+        const SectionRange& section = header.sections[i];
+        if (section.offset % 8 != 0 || section.offset < sizeof(Header) || section.offset > size ||
+            section.size > size - section.offset || section.size != expected[i]) {
+            return reject("corrupt header");
+        }
+    }
+
+    Checksum checksum;
+    checksum.update(base + align8(sizeof(Header)), size - align8(sizeof(Header)));
+    if (checksum.finish() != header.checksum) {
+        return reject("checksum mismatch");
+    }
+
+    auto section = [&](Section s) { return base + header.sections[s].offset; };
+
+    auto mapped = make_shared<ScanResult::Mapped>();
+    mapped->count = count;
+    mapped->dir_count = header.dir_count;
+    mapped->names = section(kNames);
+    mapped->name_offsets = reinterpret_cast<const uint32_t*>(section(kNameOffsets));
+    mapped->parents = reinterpret_cast<const uint32_t*>(section(kParents));
+    mapped->sizes = reinterpret_cast<const uint64_t*>(section(kSizes));
+    mapped->mtimes = reinterpret_cast<const fs::file_time_type::rep*>(section(kMtimes));
+    mapped->depths = reinterpret_cast<const uint32_t*>(section(kDepths));
+    mapped->flags = reinterpret_cast<const uint8_t*>(section(kFlags));
+    mapped->dirs = reinterpret_cast<const ScanResult::DirTotals*>(section(kDirs));
+
+    // 校验和只防损坏；名称偏移、父链和目录表再检查一遍，保证name()/path()/subtree_end()不越界、不成环
+    const uint64_t names_size = header.sections[kNames].size;
+    if (mapped->name_offsets[0] != 0 || mapped->name_offsets[count] != names_size) {
+        return reject("corrupt name table");
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (mapped->name_offsets[i + 1] < mapped->name_offsets[i] ||
+            (mapped->parents[i] != ScanResult::kNoParent && mapped->parents[i] >= i)) {
+            return reject("corrupt entry table");
+        }
+    }
+    for (uint64_t d = 0; d < header.dir_count; d++) {
+        const ScanResult::DirTotals& dir = mapped->dirs[d];
+        if (dir.index >= count || (d > 0 && dir.index <= mapped->dirs[d - 1].index) ||
+            (dir.subtree_end != 0 && (dir.subtree_end <= dir.index || dir.subtree_end > count))) {
+            return reject("corrupt directory table");
+        }
+    }
+
+    FileTreeOptions stored;
+    stored.show_size = (header.flags & kShowSize) != 0;
+    stored.human_readable = (header.flags & kHumanReadable) != 0;
+    stored.count_pruned = (header.flags & kCountPruned) != 0;
+    stored.names_only = (header.flags & kNamesOnly) != 0;
+    stored.follow_symlinks = (header.flags & kFollowSymlinks) != 0;
+    stored.count_hardlinks_once = (header.flags & kCountHardlinksOnce) != 0;
+    stored.one_filesystem = (header.flags & kOneFilesystem) != 0;
+    const uint32_t sort_order = (header.flags >> kSortOrderShift) & kSortOrderMask;
+    if (sort_order > static_cast<uint32_t>(SortOrder::MtimeDesc)) {
+        return reject("corrupt header");
+    }
+    stored.sort_order = static_cast<SortOrder>(sort_order);
+    stored.size_units = (header.flags & kSiUnits) != 0 ? SizeUnits::SI : SizeUnits::Binary;
+    const uint32_t size_precision = (header.flags >> kSizePrecisionShift) & kSizePrecisionMask;
+    if (size_precision > 0) {
+        stored.size_precision = min(static_cast<int>(size_precision) - 1, kMaxSizePrecision);
+    }
+    stored.max_depth = header.max_depth;
+    stored.max_children_per_dir = header.max_children_per_dir;
+
+    string root;
+    uint32_t pattern_count = 0;
+    StringReader strings(section(kStrings), header.sections[kStrings].size);
+    if (!strings.read_string(root) || !strings.read_u32(pattern_count)) {
+        return reject("corrupt string table");
+    }
+    for (uint32_t i = 0; i < pattern_count; i++) {
+        string pattern;
+        if (!strings.read_string(pattern)) {
+            return reject("corrupt string table");
+        }
+        stored.exclude_patterns.push_back(std::move(pattern));
+    }
+    uint32_t policy_count = 0;
+    if (!strings.read_u32(policy_count)) {
+        return reject("corrupt string table");
+    }
+    for (uint32_t i = 0; i < policy_count; i++) {
+        string policy;
+        if (!strings.read_string(policy)) {
+            return reject("corrupt string table");
+        }
+        stored.mount_policies.push_back(std::move(policy));
+    }
+
+    auto snapshot = make_shared<ScanSnapshot>(root, stored);
+    mapped->keepalive = std::move(keepalive);
+    snapshot->result_.mapped_ = std::move(mapped);
+
+    // 目录标识只在增量扫描时使用，数量与目录数相当，复制出来
+    const DiskRecord* records = reinterpret_cast<const DiskRecord*>(section(kRecords));
+    snapshot->records_.reserve(header.record_count);
+    for (uint64_t i = 0; i < header.record_count; i++) {
+        const DiskRecord& disk = records[i];
+        ScanSnapshot::DirRecord record;
+        record.index = disk.index;
+        record.stamp.device = disk.device;
+        record.stamp.inode = disk.inode;
+        record.stamp.mtime_ns = disk.mtime_ns;
+        record.stamp.ctime_ns = disk.ctime_ns;
+        record.pruned.size = disk.pruned_size;
+        record.pruned.file_count = disk.pruned_files;
+        record.pruned.dir_count = disk.pruned_dirs;
+        record.pruned.includes_pruned = disk.includes_pruned != 0;
+        if (record.index == ScanResult::kNoParent) {
+            snapshot->root_record_ = record;
+            snapshot->has_root_record_ = true;
+        } else {
+            snapshot->records_.push_back(record);
+        }
+    }
+    snapshot->complete_ = (header.flags & kComplete) != 0;
+
+    if (options) {
+        *options = std::move(stored);
+    }
+    return snapshot;
+}
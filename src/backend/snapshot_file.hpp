@@ -0,0 +1,27 @@
+#pragma once
+
+#include "scan_snapshot.hpp"
+#include <memory>
+
+// 扫描快照的磁盘格式：服务重启后不必重新扫描就能提供上次的结果
+//
+// 文件由固定大小的头部和若干按8字节对齐的段组成：
+//   头部      魔数、版本、字节序标记、条目数/目录数、扫描选项、各段的偏移和长度、校验和
+//   字符串表  根目录路径、排除模式和挂载点规则（长度前缀）
+//   名称      所有条目的名称连续存放
+//   条目列    名称偏移、父目录下标、大小、修改时间、深度、标志位，每列一个数组
+//   目录表    每个目录的条目下标和子树文件数/目录数（按下标有序）
+//   目录标识  增量扫描用的DirStamp和裁剪汇总（普通扫描的快照没有）
+//
+// 条目列和目录表与ScanResult在内存中的布局相同，加载时只做校验、不解析：
+// ScanResult直接读取映射的内存，info()等按需构造FileInfo。
+// 按本机字节序写入，字节序标记不符的文件拒绝加载
+class SnapshotFile {
+public:
+    // 写入file：先写同目录下的临时文件，落盘后改名替换，读者不会看到写了一半的文件
+    static bool write(const fs::path& file, const ScanSnapshot& snapshot, const FileTreeOptions& options);
+
+    // 映射file并校验，options（可为空）填入扫描时的选项。
+    // 文件不存在、版本不符、校验失败时返回nullptr
+    static std::shared_ptr<const ScanSnapshot> load(const fs::path& file, FileTreeOptions* options = nullptr);
+};
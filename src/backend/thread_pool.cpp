@@ -0,0 +1,121 @@
+#include "thread_pool.hpp"
+#include <iostream>
+#include <exception>
+
+using namespace std;
+
+// 当前线程所属的线程池及其队列编号（非工作线程为nullptr）
+static thread_local WorkStealingPool* tls_pool = nullptr;
+static thread_local size_t tls_index = 0;
+
+WorkStealingPool::WorkStealingPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        queues_.push_back(make_unique<WorkerQueue>());
+    }
+    
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        workers_.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    size_t index;
+    if (tls_pool == this) {
+        index = tls_index;
+    } else {
+        index = next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+    }
+    
+    pending_.fetch_add(1, memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    
+    {
+        lock_guard<mutex> lock(idle_mutex_);
+        queued_.fetch_add(1, memory_order_relaxed);
+    }
+    work_cv_.notify_one();
+}
+
+void WorkStealingPool::wait_idle() {
+    unique_lock<mutex> lock(idle_mutex_);
+    done_cv_.wait(lock, [this]() { return pending_.load() == 0; });
+}
+
+bool WorkStealingPool::pop_local(size_t index, Task& task) {
+    WorkerQueue& queue = *queues_[index];
+    lock_guard<mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset < queues_.size(); offset++) {
+        WorkerQueue& queue = *queues_[(thief + offset) % queues_.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::worker_loop(size_t index) {
+    tls_pool = this;
+    tls_index = index;
+    
+    while (true) {
+        Task task;
+        if (pop_local(index, task) || steal(index, task)) {
+            queued_.fetch_sub(1, memory_order_relaxed);
+            
+            try {
+                task();
+            } catch (const exception& e) {
+                cerr << "Worker task failed: " << e.what() << endl;
+            } catch (...) {
+                cerr << "Worker task failed with unknown error" << endl;
+            }
+            
+            if (pending_.fetch_sub(1) == 1) {
+                lock_guard<mutex> lock(idle_mutex_);
+                done_cv_.notify_all();
+            }
+            continue;
+        }
+        
+        unique_lock<mutex> lock(idle_mutex_);
+        work_cv_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池：每个工作线程有自己的任务队列，
+// 本线程提交的任务压入自己队列尾部（LIFO，保持局部性），
+// 空闲线程从其他队列头部窃取（FIFO，优先拿到较大的子树）
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+    
+    explicit WorkStealingPool(size_t thread_count);
+    ~WorkStealingPool();
+    
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    
+    // 提交任务：在工作线程内提交时进入当前线程的队列，否则轮流分配
+    void submit(Task task);
+    
+    // 等待所有已提交的任务（包括任务中再提交的任务）执行完毕
+    void wait_idle();
+    
+    size_t size() const { return workers_.size(); }
+    
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    void worker_loop(size_t index);
+    bool pop_local(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    
+    std::atomic<size_t> pending_{0};  // 已提交但未完成的任务数
+    std::atomic<size_t> queued_{0};  // 仍在队列中等待执行的任务数
+    std::atomic<size_t> next_queue_{0};
+    bool stopping_{false};
+    
+    std::mutex idle_mutex_;
+    std::condition_variable work_cv_;  // 唤醒空闲工作线程
+    std::condition_variable done_cv_;  // 通知wait_idle
+};
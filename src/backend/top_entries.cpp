@@ -0,0 +1,51 @@
+#include "top_entries.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// 堆顶为最小的条目
+bool larger(const TopEntries::Entry& a, const TopEntries::Entry& b) {
+    return a.size > b.size;
+}
+
+}
+
+void TopEntries::file(const FileInfo& file) {
+    // 汇总条目不是一个文件（其大小仍计入所在目录）
+    if (file.omitted) {
+        return;
+    }
+    offer(files_, file, file.size, 0, 0);
+}
+
+void TopEntries::leave_directory(const FileInfo& dir, const SubtreeTotals& totals) {
+    offer(dirs_, dir, totals.size, totals.file_count, totals.dir_count);
+}
+
+void TopEntries::offer(vector<Entry>& heap, const FileInfo& info, uintmax_t size,
+                       uintmax_t file_count, uintmax_t dir_count) {
+    if (limit_ == 0) {
+        return;
+    }
+    if (heap.size() < limit_) {
+        heap.push_back({info.path, size, file_count, dir_count});
+        push_heap(heap.begin(), heap.end(), larger);
+        return;
+    }
+    // 与最小者相同时保留先到的，结果不随后到的同大小条目变化
+    if (size <= heap.front().size) {
+        return;
+    }
+    pop_heap(heap.begin(), heap.end(), larger);
+    heap.back() = {info.path, size, file_count, dir_count};
+    push_heap(heap.begin(), heap.end(), larger);
+}
+
+vector<TopEntries::Entry> TopEntries::sorted(vector<Entry> heap) {
+    sort(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) {
+        return a.size != b.size ? a.size > b.size : a.path < b.path;
+    });
+    return heap;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "scan_visitor.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// 最大的文件和目录：作为ScanVisitor挂到流式扫描上，各用一个容量为limit的最小堆
+// 保留当前最大的limit个条目，其余条目看过即丢弃，内存与扫描的条目总数无关。
+// 目录按子树汇总的大小（leave_directory时）参与比较，根目录本身不计入
+class TopEntries : public ScanVisitor {
+public:
+    struct Entry {
+        std::string path;
+        uintmax_t size;
+        uintmax_t file_count;  // 目录：子树中的文件数（文件为0）
+        uintmax_t dir_count;  // 目录：子树中的子目录数（文件为0）
+    };
+
+    explicit TopEntries(size_t limit) : limit_(limit) {}
+
+    void file(const FileInfo& file) override;
+    void leave_directory(const FileInfo& dir, const SubtreeTotals& totals) override;
+
+    // 按大小从大到小（大小相同时按路径）
+    std::vector<Entry> largest_files() const { return sorted(files_); }
+    std::vector<Entry> largest_directories() const { return sorted(dirs_); }
+
+private:
+    // 满了以后只有比堆顶（已保留的最小者）更大的条目才构造Entry
+    void offer(std::vector<Entry>& heap, const FileInfo& info, uintmax_t size,
+               uintmax_t file_count, uintmax_t dir_count);
+    static std::vector<Entry> sorted(std::vector<Entry> heap);
+
+    const size_t limit_;
+    std::vector<Entry> files_;  // 最小堆
+    std::vector<Entry> dirs_;  // 最小堆
+};
@@ -0,0 +1,626 @@
+#include "tree_text_writer.hpp"
+#include "scan_result.hpp"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+void append_number(string& out, uintmax_t value) {
+    char buffer[24];
+    char* p = to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    out.append(buffer, p);
+}
+
+void append_time(string& out, fs::file_time_type time) {
+    char buffer[kTimeTextCapacity];
+    out.append(buffer, format_iso8601(buffer, FileSystemScanner::to_unix_time(time)));
+}
+
+// JSON字符串（含引号），UTF-8字节原样输出，只转义控制字符
+void append_json_string(string& out, string_view text) {
+    static const char digits[] = "0123456789abcdef";
+    out += '"';
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b";  break;
+            case '\f': out += "\\f";  break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += digits[c >> 4];
+                    out += digits[c & 0xf];
+                } else {
+                    out += ch;
+                }
+        }
+    }
+    out += '"';
+}
+
+void append_csv_field(string& out, string_view text) {
+    if (text.find_first_of(",\"\r\n") == string_view::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (char ch : text) {
+        if (ch == '"') {
+            out += '"';
+        }
+        out += ch;
+    }
+    out += '"';
+}
+
+const char* entry_type(const FileInfo& info) {
+    return info.is_directory ? "directory" : info.omitted ? "omitted" : "file";
+}
+
+// 汇总条目的名称："… 498,212 more files"（ASCII格式用"..."）。
+// 扫描只把两个以上的文件合为汇总条目，单数只出现在旧版本写下的快照中
+void append_omitted(string& out, const FileInfo& info, string_view ellipsis = "…") {
+    char buffer[kCountTextCapacity];
+    out += ellipsis;
+    out += ' ';
+    out.append(buffer, format_count(buffer, info.file_count));
+    out += info.file_count == 1 ? " more file" : " more files";
+}
+
+}
+
+template <class Format>
+TreeWriter<Format>::TreeWriter(const FileTreeOptions& options, Output output, string_view root, bool sizes_known)
+    : options_(options),
+      show_size_(options.show_size && !options.names_only),
+      sizes_known_(sizes_known),
+      output_(std::move(output)),
+      prefix_(Format::kIndent),
+      prefix_length_(1, Format::kIndent.size()) {
+    Format::begin(buffer_, root, options);
+}
+
+template <class Format>
+void TreeWriter<Format>::enter_directory(const FileInfo& dir) {
+    dirs_++;
+    open_slots_.push_back(render(dir, sizes_known_));
+}
+
+template <class Format>
+void TreeWriter<Format>::file(const FileInfo& file) {
+    files_ += file.omitted ? file.file_count : 1;
+    render(file, true);
+}
+
+template <class Format>
+void TreeWriter<Format>::leave_directory(const FileInfo& dir, const SubtreeTotals& totals) {
+    size_t slot = open_slots_.back();
+    open_slots_.pop_back();
+
+    const size_t depth = static_cast<size_t>(max(dir.depth, 1));
+    Format::close_directory(current(), string_view(prefix_).substr(0, prefix_length_[depth - 1]), dir);
+
+    if (slot == kNoSlot) {
+        flush(false);
+        return;
+    }
+
+    Format::size(held_[slot], totals.size, options_);
+    if (--unresolved_ == 0) {
+        for (const auto& segment : held_) {
+            buffer_ += segment;
+        }
+        held_.clear();
+        flush(false);
+    }
+}
+
+template <class Format>
+void TreeWriter<Format>::resume_under(const FileInfo& dir) {
+    advance_prefix(dir);
+}
+
+template <class Format>
+void TreeWriter<Format>::finish() {
+    for (const auto& segment : held_) {
+        buffer_ += segment;
+    }
+    held_.clear();
+    unresolved_ = 0;
+    Format::end(buffer_, dirs_, files_);
+    flush(true);
+}
+
+template <class Format>
+size_t TreeWriter<Format>::advance_prefix(const FileInfo& info) {
+    const size_t depth = static_cast<size_t>(max(info.depth, 1));
+    if (prefix_length_.size() <= depth) {
+        prefix_length_.resize(depth + 1, 0);
+    }
+
+    // 本层的片段供该条目的子项使用（同层的下一行会覆盖）
+    const size_t indent = prefix_length_[depth - 1];
+    prefix_.resize(indent);
+    prefix_ += info.last_in_directory ? Format::kBlank : Format::kContinue;
+    prefix_length_[depth] = prefix_.size();
+    return indent;
+}
+
+template <class Format>
+size_t TreeWriter<Format>::render(const FileInfo& info, bool size_known) {
+    string& out = current();
+
+    // 绘制树状结构：上层的缩进片段在渲染各层目录行时已经接好
+    out.append(prefix_, 0, advance_prefix(info));
+
+    // 添加分支符号
+    out += info.last_in_directory ? Format::kLastBranch : Format::kBranch;
+
+    Format::entry(out, info, options_);
+
+    // 添加文件大小（如果启用）：目录大小未知时留出一段，离开目录时填入
+    size_t slot = kNoSlot;
+    if (show_size_) {
+        if (size_known) {
+            Format::size(out, info.size, options_);
+        } else {
+            slot = held_.size();
+            held_.emplace_back();
+            held_.emplace_back();
+            unresolved_++;
+        }
+    }
+
+    Format::end_entry(current(), info);
+
+    if (held_.empty()) {
+        flush(false);
+    }
+    return slot;
+}
+
+template <class Format>
+void TreeWriter<Format>::flush(bool force) {
+    if (buffer_.empty()) {
+        return;
+    }
+    if (force || buffer_.size() >= kFlushThreshold) {
+        output_(buffer_);
+        buffer_.clear();
+    }
+}
+
+void TextTreeFormat::size(string& out, uintmax_t size, const FileTreeOptions& options) {
+    out += " (";
+    FileSystemScanner::append_file_size(out, size, options.human_readable, options.size_units, options.size_precision);
+    out += ')';
+}
+
+void TextTreeFormat::end(string& out, uintmax_t dirs, uintmax_t files) {
+    if (dirs == 0 && files == 0) {
+        out += "No files found.";
+    }
+}
+
+void EmojiTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    if (info.omitted) {
+        append_omitted(out, info);
+        return;
+    }
+    out += info.is_directory ? "📁 " : "📄 ";
+    out += info.name;
+}
+
+void AsciiTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    if (info.omitted) {
+        append_omitted(out, info, "...");
+        return;
+    }
+    out += info.name;
+    if (info.is_directory) {
+        out += '/';
+    }
+}
+
+void MarkdownTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    if (info.omitted) {
+        append_omitted(out, info);
+        return;
+    }
+    // 行内有特殊含义的ASCII标点都加反斜杠，名称按原样显示；
+    // 开头的"-"、"+"和"1."、"1)"会被当作子列表，也加反斜杠
+    const string_view name = info.name;
+    const size_t digits = min(name.find_first_not_of("0123456789"), name.size());
+    for (size_t i = 0; i < name.size(); i++) {
+        const char ch = name[i];
+        const bool list_marker = (i == 0 && (ch == '-' || ch == '+')) ||
+                                 (i == digits && i > 0 && (ch == '.' || ch == ')'));
+        if (list_marker || string_view("\\`*_[]()<>#!|~&").find(ch) != string_view::npos) {
+            out += '\\';
+        }
+        out += ch;
+    }
+    if (info.is_directory) {
+        out += '/';
+    }
+}
+
+void JsonTreeFormat::begin(string& out, string_view root, const FileTreeOptions& options) {
+    out += "[\n  {\"type\":\"directory\",\"name\":";
+    append_json_string(out, root.empty() ? string_view(".") : root);
+    out += ",\"contents\":[\n";
+}
+
+void JsonTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    out += "{\"type\":\"";
+    out += entry_type(info);
+    if (info.omitted) {
+        out += "\",\"files\":";
+        append_number(out, info.file_count);
+        return;
+    }
+    out += "\",\"name\":";
+    append_json_string(out, info.name);
+}
+
+void JsonTreeFormat::size(string& out, uintmax_t size, const FileTreeOptions& options) {
+    out += ",\"size\":";
+    append_number(out, size);
+}
+
+void JsonTreeFormat::end_entry(string& out, const FileInfo& info) {
+    if (info.is_directory) {
+        out += ",\"contents\":[\n";
+    } else {
+        out += info.last_in_directory ? "}\n" : "},\n";
+    }
+}
+
+void JsonTreeFormat::close_directory(string& out, string_view indent, const FileInfo& dir) {
+    out += indent;
+    out += dir.last_in_directory ? "]}\n" : "]},\n";
+}
+
+void JsonTreeFormat::end(string& out, uintmax_t dirs, uintmax_t files) {
+    out += "  ]}\n,\n  {\"type\":\"report\",\"directories\":";
+    append_number(out, dirs);
+    out += ",\"files\":";
+    append_number(out, files);
+    out += "}\n]\n";
+}
+
+void NdjsonTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    out += "{\"path\":";
+    append_json_string(out, info.path);
+    out += ",\"name\":";
+    append_json_string(out, info.name);
+    out += ",\"type\":\"";
+    out += entry_type(info);
+    out += "\",\"depth\":";
+    append_number(out, static_cast<uintmax_t>(max(info.depth, 0)));
+    if (info.omitted) {
+        out += ",\"files\":";
+        append_number(out, info.file_count);
+    }
+    if (!options.names_only) {
+        out += ",\"modified\":\"";
+        append_time(out, info.last_modified);
+        out += '"';
+    }
+}
+
+void NdjsonTreeFormat::size(string& out, uintmax_t size, const FileTreeOptions& options) {
+    out += ",\"size\":";
+    append_number(out, size);
+}
+
+void CsvTreeFormat::begin(string& out, string_view root, const FileTreeOptions& options) {
+    out += "path,name,type,depth";
+    if (!options.names_only) {
+        out += options.show_size ? ",modified,size" : ",modified";
+    }
+    out += "\r\n";
+}
+
+void CsvTreeFormat::entry(string& out, const FileInfo& info, const FileTreeOptions& options) {
+    append_csv_field(out, info.path);
+    out += ',';
+    if (info.omitted) {
+        string label;
+        append_omitted(label, info);
+        append_csv_field(out, label);
+    } else {
+        append_csv_field(out, info.name);
+    }
+    out += ',';
+    out += entry_type(info);
+    out += ',';
+    append_number(out, static_cast<uintmax_t>(max(info.depth, 0)));
+    if (!options.names_only) {
+        out += ',';
+        append_time(out, info.last_modified);
+    }
+}
+
+void CsvTreeFormat::size(string& out, uintmax_t size, const FileTreeOptions& options) {
+    out += ',';
+    append_number(out, size);
+}
+
+template class TreeWriter<EmojiTreeFormat>;
+template class TreeWriter<AsciiTreeFormat>;
+template class TreeWriter<UnicodeTreeFormat>;
+template class TreeWriter<MarkdownTreeFormat>;
+template class TreeWriter<JsonTreeFormat>;
+template class TreeWriter<NdjsonTreeFormat>;
+template class TreeWriter<CsvTreeFormat>;
+
+namespace {
+
+template <class Format>
+TreeSlice render_window(const ScanResult& files, const FileTreeOptions& options, const TreeWindow& window,
+                        const function<void(string_view)>& output) {
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    constexpr size_t kNone = TreeWindow::kNone;
+
+    size_t begin = 0;
+    size_t end = files.size();
+    int base_depth = 0;
+    string root = files.root();
+    if (window.subtree != kNone) {
+        begin = window.subtree + 1;
+        end = files.subtree_end(window.subtree);
+        base_depth = files.depth(window.subtree);
+        root = files.path(window.subtree);
+    }
+
+    // 窗口最深一层的目录不展开：下一行从其子树之后开始
+    auto next_shown = [&](size_t i) {
+        return window.depth >= 0 && files.depth(i) - base_depth > window.depth ? files.subtree_end(i) : i + 1;
+    };
+
+    size_t start = begin;
+    if (window.cursor != kNone) {
+        start = window.cursor;
+    } else if (window.depth < 0) {
+        start = begin + min(window.offset, end - begin);
+    } else {
+        for (size_t skipped = 0; skipped < window.offset && start < end; skipped++) {
+            start = next_shown(start);
+        }
+    }
+
+    // 与ScanResult::replay相同：所有条目共用一个路径缓冲，打开的目录记下自己的路径长度
+    string path = root;
+    if (!(root.empty() || root.back() == '/' || root.back() == separator)) {
+        path += separator;
+    }
+    const size_t root_length = path.size();
+
+    struct OpenDir {
+        size_t index;
+        size_t path_length;
+        bool rendered;  // 续接时起点的祖先没有画出，离开时也不输出
+    };
+    vector<OpenDir> open_dirs;
+    FileInfo entry;
+
+    auto fill = [&](size_t i, size_t path_length) {
+        entry.name.assign(files.name(i));
+        entry.path.assign(path, 0, path_length);
+        entry.is_directory = files.is_directory(i);
+        entry.size = files.file_size(i);
+        entry.last_modified = files.last_modified(i);
+        entry.depth = files.depth(i) - base_depth;
+        entry.includes_pruned = files.includes_pruned(i);
+        entry.last_in_directory = files.last_in_directory(i);
+        entry.omitted = files.omitted(i);
+        entry.file_count = entry.omitted ? files.file_count(i) : 0;
+    };
+
+    auto append_name = [&](size_t i) {
+        if (open_dirs.empty()) {
+            path.resize(root_length);
+        } else {
+            path.resize(open_dirs.back().path_length);
+            path += separator;
+        }
+        path += files.name(i);
+    };
+
+    TreeWriter<Format> writer(options, output, root, true);
+
+    auto leave = [&]() {
+        const OpenDir& dir = open_dirs.back();
+        if (dir.rendered) {
+            fill(dir.index, dir.path_length);
+            writer.leave_directory(entry, files.totals(dir.index));
+        }
+        open_dirs.pop_back();
+    };
+
+    // 从中间开始时，沿父链找出起点在窗口内的祖先，设置缩进和路径
+    if (start < end) {
+        vector<size_t> ancestors;
+        const size_t top = window.subtree == kNone ? ScanResult::kNoParent : window.subtree;
+        for (size_t a = files.parent(start); a != top; a = files.parent(a)) {
+            ancestors.push_back(a);
+        }
+        for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+            append_name(*it);
+            fill(*it, path.size());
+            writer.resume_under(entry);
+            open_dirs.push_back({*it, path.size(), false});
+        }
+    }
+
+    TreeSlice slice;
+    for (size_t i = start; i < end;) {
+        // 关闭不包含当前条目的目录
+        while (!open_dirs.empty() && open_dirs.back().index != files.parent(i)) {
+            leave();
+        }
+        if (window.limit > 0 && slice.lines == window.limit) {
+            slice.next_cursor = i;
+            break;
+        }
+
+        append_name(i);
+        // 汇总条目没有名称，路径为所在目录
+        fill(i, !files.omitted(i) ? path.size() : open_dirs.empty() ? root.size() : open_dirs.back().path_length);
+        slice.lines++;
+        if (!entry.is_directory) {
+            writer.file(entry);
+            i++;
+            continue;
+        }
+
+        writer.enter_directory(entry);
+        const size_t next = next_shown(i);
+        if (next == i + 1) {
+            open_dirs.push_back({i, path.size(), true});
+        } else {
+            writer.leave_directory(entry, files.totals(i));
+        }
+        i = next;
+    }
+
+    while (!open_dirs.empty()) {
+        leave();
+    }
+    writer.finish();
+    return slice;
+}
+
+}
+
+void check_tree_window(const ScanResult& files, TreeFormat format, const TreeWindow& window) {
+    constexpr size_t kNone = TreeWindow::kNone;
+    size_t begin = 0;
+    size_t end = files.size();
+    int base_depth = 0;
+    if (window.subtree != kNone) {
+        if (window.subtree >= files.size() || !files.is_directory(window.subtree)) {
+            throw invalid_argument("subtree is not a directory");
+        }
+        begin = window.subtree + 1;
+        end = files.subtree_end(window.subtree);
+        base_depth = files.depth(window.subtree);
+    }
+    if (window.cursor != kNone &&
+        (window.cursor < begin || window.cursor >= end ||
+         (window.depth >= 0 && files.depth(window.cursor) - base_depth > window.depth + 1))) {
+        throw invalid_argument("cursor is outside the tree window");
+    }
+    // 一段JSON从中间开始或在中间截断都不是完整的文档
+    if (format == TreeFormat::Json && (window.cursor != kNone || window.offset > 0 || window.limit > 0)) {
+        throw invalid_argument("line ranges are not supported for the json format");
+    }
+}
+
+bool find_tree_subtree(const ScanResult& files, string_view path, TreeWindow& window) {
+#ifdef _WIN32
+    const string_view separators = "/\\";
+    const bool absolute = !path.empty() && 
+                          (separators.find(path[0]) != string_view::npos || (path.size() >= 2 && path[1] == ':'));
+#else
+    const string_view separators = "/";
+    const bool absolute = !path.empty() && path[0] == '/';
+#endif
+    auto is_separator = [&separators](char c) { return separators.find(c) != string_view::npos; };
+    
+    if (absolute) {
+        // 根目录须是完整的路径前缀：其后为分隔符或结束（根目录本身以分隔符结尾时也是）
+        const string_view root = files.root();
+        if (root.empty() || path.compare(0, root.size(), root) != 0 ||
+            (path.size() > root.size() && !is_separator(root.back()) && !is_separator(path[root.size()]))) {
+            return false;
+        }
+        path.remove_prefix(root.size());
+    }
+    
+    // 只有分隔符和"."：根目录本身
+    bool root_itself = true;
+    for (size_t pos = 0; pos < path.size() && root_itself;) {
+        size_t next = pos;
+        while (next < path.size() && !is_separator(path[next])) {
+            next++;
+        }
+        const string_view part = path.substr(pos, next - pos);
+        root_itself = part.empty() || part == ".";
+        pos = next + 1;
+    }
+    if (root_itself) {
+        return true;
+    }
+    
+    const size_t found = files.find(path);
+    if (found == ScanResult::kNotFound) {
+        return false;
+    }
+    window.subtree = found;
+    return true;
+}
+
+TreeSlice write_tree(const ScanResult& files, const FileTreeOptions& options, TreeFormat format,
+                     const TreeWindow& window, const function<void(string_view)>& output) {
+    check_tree_window(files, format, window);
+    switch (format) {
+        case TreeFormat::Emoji:    return render_window<EmojiTreeFormat>(files, options, window, output);
+        case TreeFormat::Ascii:    return render_window<AsciiTreeFormat>(files, options, window, output);
+        case TreeFormat::Unicode:  return render_window<UnicodeTreeFormat>(files, options, window, output);
+        case TreeFormat::Markdown: return render_window<MarkdownTreeFormat>(files, options, window, output);
+        case TreeFormat::Ndjson:   return render_window<NdjsonTreeFormat>(files, options, window, output);
+        case TreeFormat::Csv:      return render_window<CsvTreeFormat>(files, options, window, output);
+        case TreeFormat::Json:     return render_window<JsonTreeFormat>(files, options, window, output);
+    }
+    return {};
+}
+
+namespace {
+
+const struct {
+    TreeFormat format;
+    const char* name;
+} kTreeFormatNames[] = {
+    {TreeFormat::Emoji, "emoji"},
+    {TreeFormat::Ascii, "ascii"},
+    {TreeFormat::Unicode, "unicode"},
+    {TreeFormat::Markdown, "markdown"},
+    {TreeFormat::Json, "json"},
+    {TreeFormat::Ndjson, "ndjson"},
+    {TreeFormat::Csv, "csv"},
+};
+
+}
+
+const char* tree_format_name(TreeFormat format) {
+    for (const auto& entry : kTreeFormatNames) {
+        if (entry.format == format) {
+            return entry.name;
+        }
+    }
+    return "emoji";
+}
+
+bool parse_tree_format(string_view name, TreeFormat& format) {
+    for (const auto& entry : kTreeFormatNames) {
+        if (name == entry.name) {
+            format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "scan_visitor.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ScanResult;
+
+// 流式文件树渲染：作为ScanVisitor挂到扫描上，边扫描边输出文本，
+// 也可由ScanResult::replay驱动（generate_tree_text即如此）
+//
+// 扫描时已标出每个目录的最后一个条目（FileInfo::last_in_directory），
+// 每行在条目到达时即可画出，不必向后看，深度不受限制。
+// 显示大小时，目录行要等离开该目录才知道大小：在此之前该行及其后的
+// 文本暂存在本地，直到所有未决的目录都已离开再交给output。
+// 各层的缩进片段随目录进出增减，每行只追加一次前缀，不逐层拼接
+//
+// 输出格式由Format决定（见下面的*Format），每行的代码在编译时按格式生成，
+// 格式的选择只在开始时按TreeFormat分派一次（write_tree）
+template <class Format>
+class TreeWriter final : public ScanVisitor {
+public:
+    using Output = std::function<void(std::string_view)>;
+
+    // root: 扫描的根目录（JSON格式作为最外层目录的名称）
+    // sizes_known: 进入目录时FileInfo::size已是子树总大小（由ScanResult渲染），不必等离开目录
+    TreeWriter(const FileTreeOptions& options, Output output, std::string_view root = {},
+               bool sizes_known = false);
+
+    void enter_directory(const FileInfo& dir) override;
+    void file(const FileInfo& file) override;
+    void leave_directory(const FileInfo& dir, const SubtreeTotals& totals) override;
+
+    // 从树的中间开始渲染：对起点的每个祖先目录（由外向内）调用一次，
+    // 只设置缩进，如同该目录行已经画出，不输出也不需要离开
+    void resume_under(const FileInfo& dir);
+
+    // 扫描结束：输出剩余文本
+    void finish();
+
+private:
+    static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+    static constexpr size_t kFlushThreshold = 64 * 1024;
+
+    // 画出一行；目录的大小未知时留出一段，返回其位置（否则返回kNoSlot）
+    size_t render(const FileInfo& info, bool size_known);
+    // 换到info所在的层，设置其子项的缩进片段，返回该行使用的缩进长度
+    size_t advance_prefix(const FileInfo& info);
+    std::string& current() { return held_.empty() ? buffer_ : held_.back(); }
+    void flush(bool force);
+
+    const FileTreeOptions& options_;
+    const bool show_size_;
+    const bool sizes_known_;
+    Output output_;
+
+    uintmax_t files_ = 0;
+    uintmax_t dirs_ = 0;
+    std::string prefix_;  // 各层的缩进片段依次相连
+    std::vector<size_t> prefix_length_;  // [d]: 深度d+1的行使用prefix_的前多少字节
+
+    std::string buffer_;  // 可以输出的文本
+    std::vector<std::string> held_;  // 等待目录大小的文本段（目录大小各占一段）
+    std::vector<size_t> open_slots_;  // 每个已进入目录的大小所在段，不显示大小时为kNoSlot
+    size_t unresolved_ = 0;  // 尚未填入的目录大小段数
+};
+
+// 格式的接口（均为静态成员）：
+//   kIndent                          深度1的行之前的缩进
+//   kBranch / kLastBranch            条目前的分支符号（是否为目录的最后一个条目）
+//   kContinue / kBlank               子项的缩进片段（父条目不是/是最后一个条目）
+//   begin(out, root, options)        表头
+//   entry(out, info, options)        分支符号之后的名称等
+//   size(out, size, options)         大小（目录的大小在离开目录时才写入）
+//   end_entry(out, info)             行尾
+//   close_directory(out, indent, dir)  离开目录，indent为该目录行的缩进
+//   end(out, dirs, files)            表尾，dirs/files为列出的目录/文件数
+
+// 默认：没有表头表尾，离开目录不输出
+struct TreeFormatBase {
+    static constexpr std::string_view kIndent = "";
+    static constexpr std::string_view kBranch = "";
+    static constexpr std::string_view kLastBranch = "";
+    static constexpr std::string_view kContinue = "";
+    static constexpr std::string_view kBlank = "";
+
+    static void begin(std::string& out, std::string_view root, const FileTreeOptions& options) {}
+    static void close_directory(std::string& out, std::string_view indent, const FileInfo& dir) {}
+    static void end(std::string& out, uintmax_t dirs, uintmax_t files) {}
+};
+
+// 给人看的文本：大小写作" (1.5 KB)"，没有条目时输出"No files found."
+struct TextTreeFormat : TreeFormatBase {
+    static void size(std::string& out, uintmax_t size, const FileTreeOptions& options);
+    static void end_entry(std::string& out, const FileInfo& info) { out += '\n'; }
+    static void end(std::string& out, uintmax_t dirs, uintmax_t files);
+};
+
+// ├── 📁 dir
+struct EmojiTreeFormat : TextTreeFormat {
+    static constexpr std::string_view kBranch = "├── ";
+    static constexpr std::string_view kLastBranch = "└── ";
+    static constexpr std::string_view kContinue = "│   ";
+    static constexpr std::string_view kBlank = "    ";
+
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+};
+
+// |-- dir/
+struct AsciiTreeFormat : TextTreeFormat {
+    static constexpr std::string_view kBranch = "|-- ";
+    static constexpr std::string_view kLastBranch = "`-- ";
+    static constexpr std::string_view kContinue = "|   ";
+    static constexpr std::string_view kBlank = "    ";
+
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+};
+
+// ├── dir/
+struct UnicodeTreeFormat : EmojiTreeFormat {
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options) {
+        if (info.omitted) {
+            EmojiTreeFormat::entry(out, info, options);
+        } else {
+            AsciiTreeFormat::entry(out, info, options);
+        }
+    }
+};
+
+// - dir/（子项缩进两格；名称中的Markdown符号加反斜杠）
+struct MarkdownTreeFormat : TextTreeFormat {
+    static constexpr std::string_view kBranch = "- ";
+    static constexpr std::string_view kLastBranch = "- ";
+    static constexpr std::string_view kContinue = "  ";
+    static constexpr std::string_view kBlank = "  ";
+
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+};
+
+// 与tree -J相同的结构：[根目录{contents:[...]}, {"type":"report",...}]，
+// 大小总是以字节为单位的数字（目录为子树总大小）。汇总条目为{"type":"omitted","files":...}
+struct JsonTreeFormat : TreeFormatBase {
+    static constexpr std::string_view kIndent = "    ";
+    static constexpr std::string_view kContinue = "  ";
+    static constexpr std::string_view kBlank = "  ";
+
+    static void begin(std::string& out, std::string_view root, const FileTreeOptions& options);
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+    static void size(std::string& out, uintmax_t size, const FileTreeOptions& options);
+    static void end_entry(std::string& out, const FileInfo& info);
+    static void close_directory(std::string& out, std::string_view indent, const FileInfo& dir);
+    static void end(std::string& out, uintmax_t dirs, uintmax_t files);
+};
+
+// 每个条目一行：{"path":..., "name":..., "type":..., "depth":..., "modified":..., "size":...}，
+// modified为ISO 8601（UTC），names_only时没有。汇总条目的type为"omitted"，另有"files"（文件数）
+struct NdjsonTreeFormat : TreeFormatBase {
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+    static void size(std::string& out, uintmax_t size, const FileTreeOptions& options);
+    static void end_entry(std::string& out, const FileInfo& info) { out += "}\n"; }
+};
+
+// path,name,type,depth[,modified][,size]，按RFC 4180加引号，行尾为CRLF。
+// 汇总条目的type为omitted，name为"… 498,212 more files"
+struct CsvTreeFormat : TreeFormatBase {
+    static void begin(std::string& out, std::string_view root, const FileTreeOptions& options);
+    static void entry(std::string& out, const FileInfo& info, const FileTreeOptions& options);
+    static void size(std::string& out, uintmax_t size, const FileTreeOptions& options);
+    static void end_entry(std::string& out, const FileInfo& info) { out += "\r\n"; }
+};
+
+// 渲染的范围：一个子树、一个深度窗口和一段行，可以组合。默认为整个树
+struct TreeWindow {
+    static constexpr size_t kNone = SIZE_MAX;
+
+    size_t subtree = kNone;  // 只渲染这个目录（条目下标）的子孙，kNone为整个树
+    int depth = -1;  // 与FileTreeOptions::max_depth相同（相对subtree）：0只列出直接子项，-1表示不限
+    size_t cursor = kNone;  // 从这个条目开始（上一段的next_cursor），给出时不使用offset
+    size_t offset = 0;  // 跳过的行数：不限深度时直接换算为条目下标，否则逐行跳过（越过窗口以下的子树）
+    size_t limit = 0;  // 最多输出的行数，0表示不限
+};
+
+struct TreeSlice {
+    size_t lines = 0;  // 输出的条目行数
+    size_t next_cursor = TreeWindow::kNone;  // 下一段的起点，kNone表示已经到末尾
+};
+
+// subtree参数：相对扫描根目录的路径，或根目录之下的绝对路径（按路径分隔符比较，"/a/pfxbase"不在"/a/pfx"之下）。
+// 找到目录或文件时设置window.subtree并返回true，路径为根目录本身（整个树）时不修改window.subtree；
+// 绝对路径不在根目录之下或路径不存在时返回false
+bool find_tree_subtree(const ScanResult& files, std::string_view path, TreeWindow& window);
+
+// window是否可以渲染：subtree不是目录、cursor不在窗口内，或对json格式指定行范围时抛出invalid_argument。
+// 渲染之前（例如开始发送响应之前）检查
+void check_tree_window(const ScanResult& files, TreeFormat format, const TreeWindow& window);
+
+// 按format渲染扫描结果中window的部分，文本分块交给output。
+// 用子树范围（ScanResult::subtree_end）定位和跳过，从cursor续接只需沿父链找出祖先，
+// 耗时与输出的行数（加上起点的深度）成正比，与整个树的大小无关。
+// window无效时抛出invalid_argument（见check_tree_window）
+TreeSlice write_tree(const ScanResult& files, const FileTreeOptions& options, TreeFormat format,
+                     const TreeWindow& window, const std::function<void(std::string_view)>& output);
+
+// 格式名称："emoji"、"ascii"、"unicode"、"markdown"、"json"、"ndjson"、"csv"
+const char* tree_format_name(TreeFormat format);
+bool parse_tree_format(std::string_view name, TreeFormat& format);
@@ -0,0 +1,171 @@
+#include "value_format.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// "00" "01" ... "99"：两位数字一次写出
+const char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+constexpr uint64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+constexpr uintmax_t kBinaryDivisors[] = {1, uintmax_t(1) << 10, uintmax_t(1) << 20, uintmax_t(1) << 30, uintmax_t(1) << 40};
+constexpr uintmax_t kSiDivisors[] = {1, 1000, 1000000, 1000000000, 1000000000000};
+
+// 带前导空格，与原来的输出一致
+const char* const kBinaryUnits[] = {" B", " KB", " MB", " GB", " TB"};
+const char* const kSiUnits[] = {" B", " kB", " MB", " GB", " TB"};
+
+inline char* write_pair(char* out, unsigned value) {
+    memcpy(out, kDigitPairs + value * 2, 2);
+    return out + 2;
+}
+
+// value的低digits位十进制数字（不足时补0）
+inline char* write_fixed(char* out, uint64_t value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + digits;
+}
+
+inline char* write_unit(char* out, const char* unit) {
+    const size_t length = strlen(unit);
+    memcpy(out, unit, length);
+    return out + length;
+}
+
+}
+
+char* format_size(char* out, uintmax_t size, SizeUnits units, int precision) {
+    precision = max(0, min(precision, kMaxSizePrecision));
+    const uintmax_t* divisors = units == SizeUnits::Binary ? kBinaryDivisors : kSiDivisors;
+    const char* const* labels = units == SizeUnits::Binary ? kBinaryUnits : kSiUnits;
+
+    int unit_index = 0;
+    while (unit_index < 4 && size >= divisors[unit_index + 1]) {
+        unit_index++;
+    }
+
+    // 1024进制的除数是2的幂，用移位代替除法
+    const bool binary = units == SizeUnits::Binary;
+    uintmax_t divisor = divisors[unit_index];
+    int shift = 10 * unit_index;
+
+    // 1024进制超过2^53时，以往的输出先把size转换为double：同样把size舍入到53位有效数字
+    // （恰好一半时取偶数），结果逐字节相同。除数同时缩小，商不变
+    constexpr uintmax_t kExactLimit = uintmax_t(1) << 53;
+    if (binary && size >= kExactLimit) {
+        int dropped_bits = 0;
+        while ((size >> dropped_bits) >= kExactLimit) {
+            dropped_bits++;
+        }
+        const uintmax_t dropped = size & ((uintmax_t(1) << dropped_bits) - 1);
+        const uintmax_t half = uintmax_t(1) << (dropped_bits - 1);
+        size >>= dropped_bits;
+        if (dropped > half || (dropped == half && (size & 1))) {
+            size++;
+        }
+        shift -= dropped_bits;
+        divisor >>= dropped_bits;
+    }
+
+    // size / divisor保留precision位小数：整数部分加上余数按比例换算的小数部分，
+    // 与printf一样按精确值舍入，恰好一半时取偶数。余数 < 10^12，乘10^6不会溢出
+    const uint64_t scale = kPow10[precision];
+    uintmax_t value;
+    uintmax_t remainder;
+    if (binary) {
+        const uintmax_t mask = divisor - 1;
+        const uintmax_t scaled = (size & mask) * scale;
+        value = (size >> shift) * scale + (scaled >> shift);
+        remainder = scaled & mask;
+    } else {
+        const uintmax_t scaled = (size % divisor) * scale;
+        value = size / divisor * scale + scaled / divisor;
+        remainder = scaled % divisor;
+    }
+    if (remainder * 2 > divisor || (remainder * 2 == divisor && (value & 1))) {
+        value++;
+    }
+
+    out = to_chars(out, out + 24, value / scale).ptr;
+    if (precision > 0) {
+        *out++ = '.';
+        out = write_fixed(out, value % scale, precision);
+    }
+    return write_unit(out, labels[unit_index]);
+}
+
+char* format_bytes(char* out, uintmax_t size) {
+    out = to_chars(out, out + 24, size).ptr;
+    return write_unit(out, " B");
+}
+
+char* format_count(char* out, uintmax_t count) {
+    char digits[24];
+    const int length = static_cast<int>(to_chars(digits, digits + sizeof(digits), count).ptr - digits);
+    for (int i = 0; i < length; i++) {
+        if (i > 0 && (length - i) % 3 == 0) {
+            *out++ = ',';
+        }
+        *out++ = digits[i];
+    }
+    return out;
+}
+
+char* format_iso8601(char* out, int64_t unix_seconds, uint32_t nanoseconds, int fraction_digits) {
+    // 按UTC拆成日期和一天内的秒数（向下取整，1970年以前也正确）
+    int64_t days = unix_seconds / 86400;
+    int64_t second_of_day = unix_seconds % 86400;
+    if (second_of_day < 0) {
+        second_of_day += 86400;
+        days--;
+    }
+
+    // 公历日期（Howard Hinnant的civil_from_days算法，纪元移到0000-03-01，以400年为周期）
+    const int64_t z = days + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t day_of_era = z - era * 146097;
+    const int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int64_t shifted_month = (5 * day_of_year + 2) / 153;
+    const unsigned day = static_cast<unsigned>(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+    const unsigned month = static_cast<unsigned>(shifted_month < 10 ? shifted_month + 3 : shifted_month - 9);
+    const int64_t year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+    if (year >= 0 && year <= 9999) {
+        out = write_pair(out, static_cast<unsigned>(year / 100));
+        out = write_pair(out, static_cast<unsigned>(year % 100));
+    } else {
+        if (year > 0) {
+            *out++ = '+';
+        }
+        out = to_chars(out, out + 24, year).ptr;
+    }
+    *out++ = '-';
+    out = write_pair(out, month);
+    *out++ = '-';
+    out = write_pair(out, day);
+    *out++ = 'T';
+    out = write_pair(out, static_cast<unsigned>(second_of_day / 3600));
+    *out++ = ':';
+    out = write_pair(out, static_cast<unsigned>(second_of_day / 60 % 60));
+    *out++ = ':';
+    out = write_pair(out, static_cast<unsigned>(second_of_day % 60));
+
+    fraction_digits = max(0, min(fraction_digits, 9));
+    if (fraction_digits > 0) {
+        *out++ = '.';
+        out = write_fixed(out, (nanoseconds % 1000000000) / kPow10[9 - fraction_digits], fraction_digits);
+    }
+    *out++ = 'Z';
+    return out;
+}
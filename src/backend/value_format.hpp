@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 大小和时间的格式化：写入调用方提供的缓冲区（至少k*Capacity字节），返回写入的末尾。
+// 只做整数运算和查表，不分配内存，不经过流，不受locale影响
+
+// 人类可读大小的单位
+enum class SizeUnits {
+    Binary,  // 1024进制，写作KB、MB、GB、TB
+    SI,  // 1000进制，写作kB、MB、GB、TB
+};
+
+constexpr int kMaxSizePrecision = 6;
+constexpr size_t kSizeTextCapacity = 40;
+constexpr size_t kTimeTextCapacity = 40;
+constexpr size_t kCountTextCapacity = 32;
+
+// "1.50 KB"：precision为小数位数（0到kMaxSizePrecision），按精确值舍入，恰好一半时取偶数
+char* format_size(char* out, uintmax_t size, SizeUnits units = SizeUnits::Binary, int precision = 2);
+
+// "1536 B"
+char* format_bytes(char* out, uintmax_t size);
+
+// "498,212"：每三位加逗号
+char* format_count(char* out, uintmax_t count);
+
+// ISO 8601（UTC）："2024-05-01T12:34:56Z"。fraction_digits为秒的小数位数（0到9，截断），
+// 年份超出0000-9999时按扩展格式写出符号和全部位数
+char* format_iso8601(char* out, int64_t unix_seconds, uint32_t nanoseconds = 0, int fraction_digits = 0);
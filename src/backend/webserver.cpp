@@ -1,12 +1,17 @@
 #include "webserver.hpp"
+#include "top_entries.hpp"
+#include "duplicate_finder.hpp"
+#include "tree_text_writer.hpp"
+#include "json_document.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cstdio>
-#include <regex>
 #include <map>
+#include <climits>
+#include <condition_variable>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -30,8 +35,9 @@ static std::wstring utf8_to_wstring(const std::string& str) {
 }
 
 // UTF-8 友好的 JSON 字符串转义函数
-static string escape_json_string(const string& input) {
+static string escape_json_string(string_view input) {
     string output;
+    output.reserve(input.size());
     for (size_t i = 0; i < input.size(); i++) {
         unsigned char c = input[i];
         switch (c) {
@@ -57,6 +63,180 @@ static string escape_json_string(const string& input) {
     return output;
 }
 
+// 扫描提前结束原因的JSON值
+static const char* scan_stop_reason(ScanStop stopped) {
+    switch (stopped) {
+        case ScanStop::Cancelled: return "cancelled";
+        case ScanStop::TimeLimit: return "time_limit";
+        case ScanStop::EntryLimit: return "entry_limit";
+        case ScanStop::None: break;
+    }
+    return "";
+}
+
+// 按请求的选项格式化大小，写入buffer（不分配）
+static string_view size_text(char (&buffer)[kSizeTextCapacity], uintmax_t size, const FileTreeOptions& options) {
+    char* end = options.human_readable ? format_size(buffer, size, options.size_units, options.size_precision)
+                                       : format_bytes(buffer, size);
+    return string_view(buffer, static_cast<size_t>(end - buffer));
+}
+
+// 修改时间，ISO 8601（UTC）
+static string_view time_text(char (&buffer)[kTimeTextCapacity], fs::file_time_type time) {
+    char* end = format_iso8601(buffer, FileSystemScanner::to_unix_time(time));
+    return string_view(buffer, static_cast<size_t>(end - buffer));
+}
+
+// 请求对象的顶层字符串、数字、布尔值和null（字符串已解码，其余为原文）；
+// 数组和对象不在其中，直接从文档读取
+static map<string, string> json_params(const JsonDocument& document) {
+    map<string, string> params;
+    if (document.empty() || document.type(0) != JsonType::Object) {
+        return params;
+    }
+    for (size_t i = 1; i < document.end(0); i = document.end(i)) {
+        if (document.type(i) != JsonType::Array && document.type(i) != JsonType::Object) {
+            params[string(document.key(i))] = string(document.text(i));
+        }
+    }
+    return params;
+}
+
+// 数组中的字符串（去掉首尾空白，跳过空串和其他类型的值）追加到out；array不是数组时不做任何事
+static void append_strings(const JsonDocument& document, size_t array, vector<string>& out) {
+    if (array == JsonDocument::kNotFound || document.type(array) != JsonType::Array) {
+        return;
+    }
+    for (size_t i = array + 1; i < document.end(array); i = document.end(i)) {
+        if (document.type(i) != JsonType::String) {
+            continue;
+        }
+        const string_view value = document.text(i);
+        const size_t first = value.find_first_not_of(" \t");
+        if (first != string_view::npos) {
+            out.emplace_back(value.substr(first, value.find_last_not_of(" \t") - first + 1));
+        }
+    }
+}
+
+// 文件树格式对应的Content-Type和下载文件扩展名
+static const char* tree_content_type(TreeFormat format) {
+    switch (format) {
+        case TreeFormat::Markdown: return "text/markdown; charset=utf-8";
+        case TreeFormat::Json: return "application/json";
+        case TreeFormat::Ndjson: return "application/x-ndjson";
+        case TreeFormat::Csv: return "text/csv; charset=utf-8";
+        default: break;
+    }
+    return "text/plain; charset=utf-8";
+}
+
+static const char* tree_file_extension(TreeFormat format) {
+    switch (format) {
+        case TreeFormat::Markdown: return ".md";
+        case TreeFormat::Json: return ".json";
+        case TreeFormat::Ndjson: return ".ndjson";
+        case TreeFormat::Csv: return ".csv";
+        default: break;
+    }
+    return ".txt";
+}
+
+static const char* const kTreeFormatList = "emoji, ascii, unicode, markdown, json, ndjson, csv";
+
+// 文件树的渲染范围（/api/tree的请求体和/api/download/tree的查询参数相同）：
+//   subtree  目录路径（相对扫描根目录，或以根目录开头的绝对路径），index  直接给出条目下标
+//   depth    与max_depth相同，相对subtree
+//   offset / limit  跳过/最多输出的行数，cursor  上一段返回的next_cursor
+// 参数无效时返回false并设置error
+static bool parse_tree_window(const ScanResult& files, map<string, string>& params, TreeWindow& window, string& error) {
+    auto number = [&](const char* name, size_t& value) {
+        auto it = params.find(name);
+        if (it == params.end() || it->second.empty() || it->second == "null") {
+            return true;
+        }
+        try {
+            size_t used = 0;
+            value = stoull(it->second, &used);
+            if (used == it->second.size() && it->second[0] != '-') {
+                return true;
+            }
+        } catch (...) {
+        }
+        error = string("Invalid ") + name + ": " + it->second;
+        return false;
+    };
+
+    // 与max_depth相同，负数表示不限
+    size_t depth = TreeWindow::kNone;
+    if (params.find("depth") != params.end() && params["depth"].rfind('-', 0) == 0) {
+        params.erase("depth");
+    }
+    if (!number("index", window.subtree) || !number("depth", depth) || !number("offset", window.offset) ||
+        !number("limit", window.limit) || !number("cursor", window.cursor)) {
+        return false;
+    }
+    window.depth = depth == TreeWindow::kNone ? -1 : static_cast<int>(min<size_t>(depth, INT_MAX));
+
+    // 相对根目录的路径或根目录之下的绝对路径，根目录本身为整个树
+    if (params.find("subtree") != params.end() && !params["subtree"].empty() &&
+        !find_tree_subtree(files, params["subtree"], window)) {
+        error = "Subtree not found: " + params["subtree"];
+        return false;
+    }
+    return true;
+}
+
+// 扫描期间定期检查客户端连接，连接断开（例如关闭了页面）时取消扫描
+class DisconnectWatcher {
+public:
+    DisconnectWatcher(const httplib::Request& req, shared_ptr<CancellationToken> token)
+        : thread_([this, &req, token]() {
+              unique_lock<mutex> lock(mutex_);
+              while (!cv_.wait_for(lock, chrono::milliseconds(250), [this]() { return done_; })) {
+                  if (req.is_connection_closed()) {
+                      token->cancel();
+                      break;
+                  }
+              }
+          }) {}
+    
+    ~DisconnectWatcher() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+    
+private:
+    mutex mutex_;
+    condition_variable cv_;
+    bool done_ = false;
+    thread thread_;  // 最后初始化
+};
+
+class WebServer::ScanRegistration {
+public:
+    ScanRegistration(WebServer& server, string client_id, shared_ptr<CancellationToken> token)
+        : server_(server), client_id_(std::move(client_id)), token_(std::move(token)) {
+        server_.begin_scan(client_id_, token_);
+    }
+    
+    ~ScanRegistration() {
+        server_.end_scan(client_id_, token_);
+    }
+    
+    ScanRegistration(const ScanRegistration&) = delete;
+    ScanRegistration& operator=(const ScanRegistration&) = delete;
+    
+private:
+    WebServer& server_;
+    const string client_id_;
+    const shared_ptr<CancellationToken> token_;
+};
+
 WebServer::WebServer() {
     // 创建上传目录
     try {
@@ -66,10 +246,25 @@ WebServer::WebServer() {
     } catch (const fs::filesystem_error& e) {
         cerr << "Failed to create upload directory: " << e.what() << endl;
     }
+    
+    // 恢复上次运行保存的扫描结果
+    try {
+        if (!fs::exists(snapshot_dir_)) {
+            fs::create_directory(snapshot_dir_);
+        }
+        load_saved_snapshots();
+    } catch (const fs::filesystem_error& e) {
+        cerr << "Failed to load saved snapshots: " << e.what() << endl;
+    }
 }
 
 WebServer::~WebServer() {
     stop();
+    
+    lock_guard<mutex> lock(persist_mutex_);
+    if (persist_thread_.joinable()) {
+        persist_thread_.join();
+    }
 }
 
 bool WebServer::start(int port) {
@@ -84,6 +279,11 @@ bool WebServer::start(int port) {
     // 设置路由
     setup_routes();
     
+    // 压缩生成好的API响应（边生成边发送的响应由stream_response压缩）
+    server_->set_post_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+        compress_response(req, res);
+    });
+    
     // 设置静态文件服务（前端文件）
     server_->set_base_dir("./frontend");
     
@@ -136,6 +336,18 @@ void WebServer::setup_routes() {
         handle_scan(req, res);
     });
     
+    server_->Post("/api/scan/cancel", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_scan_cancel(req, res);
+    });
+    
+    server_->Post("/api/top", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_top(req, res);
+    });
+    
+    server_->Post("/api/duplicates", [this](const httplib::Request& req, httplib::Response& res) {
+        handle_duplicates(req, res);
+    });
+    
     server_->Post("/api/tree", [this](const httplib::Request& req, httplib::Response& res) {
         handle_tree(req, res);
     });
@@ -279,7 +491,14 @@ void WebServer::handle_upload(const httplib::Request& req, httplib::Response& re
 void WebServer::handle_scan(const httplib::Request& req, httplib::Response& res) {
     try {
         // 解析请求参数
-        auto params = parse_simple_json(req.body);
+        string json_error;
+        auto params = parse_simple_json(req.body, &json_error);
+        
+        if (!json_error.empty()) {
+            res.set_content(generate_json_response(false, "Invalid JSON request: " + json_error), 
+                           "application/json");
+            return;
+        }
         
         if (params.find("path") == params.end() || params["path"].empty()) {
             res.set_content(generate_json_response(false, "Missing path parameter"), 
@@ -304,12 +523,54 @@ void WebServer::handle_scan(const httplib::Request& req, httplib::Response& res)
         // 最好是在 main.cpp 或 filesystem.cpp 统一处理，但现在先修复上传的 json 错误。
         // 上传错误是因为 handle_upload 里的路径处理。
         
-        vector<FileInfo> files = FileSystemScanner::scan_directory(path_utf8, options);
+        // 同一客户端的新扫描、取消请求或断开连接都会终止本次扫描
+        string client_id = scan_client_id(req, params);
+        auto token = make_shared<CancellationToken>();
+        options.cancel_token = token;
+        
+        // 增量扫描：与该根目录上一次的快照比较，只重新读取变化的目录
+        const bool incremental = params.find("incremental") != params.end() && 
+                                 (params["incremental"] == "true" || params["incremental"] == "1");
+        // 实时监视：扫描后持续监视该根目录，之后的扫描直接由内存中的索引回答
+        const bool watch = params.find("watch") != params.end() && 
+                           (params["watch"] == "true" || params["watch"] == "1");
         
-        // 保存扫描结果（即使为空也保存）
-        current_scan_.path = path_utf8;
-        current_scan_.files = files;
-        current_scan_.options = options;
+        ScanStats stats;
+        shared_ptr<const ScanSnapshot> snapshot;
+        bool watched = false;
+        {
+            ScanRegistration registration(*this, client_id, token);
+            DisconnectWatcher watcher(req, token);
+            shared_ptr<LiveIndex> live = (incremental || watch) ? find_live_index(path_utf8, options) : nullptr;
+            if (live) {
+                snapshot = live->query(&stats);
+                watched = true;
+            } else if (incremental || watch) {
+                snapshot = FileSystemScanner::rescan_directory(
+                    path_utf8, options, find_snapshot(path_utf8).get(), &stats);
+                if (snapshot->complete()) {
+                    shared_ptr<LiveIndex> started = watch ? LiveIndex::start(snapshot, options, stats) : nullptr;
+                    watched = started != nullptr;
+                    store_snapshot(path_utf8, snapshot, std::move(started));
+                }
+            } else {
+                snapshot = make_shared<ScanSnapshot>(
+                    FileSystemScanner::scan_directory(path_utf8, options, &stats), options);
+            }
+        }
+        options.cancel_token.reset();
+        shared_ptr<const ScanResult> scanned(snapshot, &snapshot->result());
+        
+        // 完整扫描的结果写入快照文件，重启后直接提供（索引回答的结果上次扫描时已写过）
+        if (stats.stopped == ScanStop::None && !watched) {
+            persist_snapshot(snapshot, options);
+        }
+        
+        // 保存扫描结果（即使为空也保存）；被取消的扫描已无人等待，不覆盖
+        if (stats.stopped != ScanStop::Cancelled) {
+            set_current_scan({path_utf8, scanned, options});
+        }
+        const ScanResult& files = *scanned;
         
         // 生成响应
         string escaped_path = escape_json_string(path_utf8);
@@ -317,25 +578,176 @@ void WebServer::handle_scan(const httplib::Request& req, httplib::Response& res)
         ostringstream response_stream;
         response_stream << R"({)" << endl;
         response_stream << R"(    "success": true,)" << endl;
-        response_stream << R"(    "message": "Directory scanned successfully",)" << endl;
+        response_stream << R"(    "message": ")" 
+                        << (stats.truncated() ? "Scan stopped early, results are partial" : "Directory scanned successfully") 
+                        << R"(",)" << endl;
         response_stream << R"(    "path": ")" << escaped_path << R"(",)" << endl;
         response_stream << R"(    "file_count": )" << files.size() << "," << endl;
+        response_stream << R"(    "truncated": )" << (stats.truncated() ? "true" : "false") << "," << endl;
+        response_stream << R"(    "truncated_reason": )" 
+                        << (stats.truncated() ? "\"" + string(scan_stop_reason(stats.stopped)) + "\"" : "null") 
+                        << "," << endl;
+        if (incremental || watch) {
+            response_stream << R"(    "incremental": true,)" << endl;
+            response_stream << R"(    "watched": )" << (watched ? "true" : "false") << "," << endl;
+            response_stream << R"(    "dirs_read": )" << stats.dirs_read << "," << endl;
+            response_stream << R"(    "dirs_reused": )" << stats.dirs_reused << "," << endl;
+        }
+        response_stream << R"(    "names_only": )" << (options.names_only ? "true" : "false") << "," << endl;
+        response_stream << R"(    "symlinks_followed": )" << stats.symlinks_followed << "," << endl;
+        response_stream << R"(    "cycles_cut": )" << stats.cycles_cut << "," << endl;
+        response_stream << R"(    "bytes_deduplicated": )" << stats.bytes_deduplicated << "," << endl;
+        response_stream << R"(    "memory_usage": )" << snapshot->memory_usage() << "," << endl;
+        response_stream << R"(    "mounts": [)";
+        for (size_t i = 0; i < stats.mounts.size(); i++) {
+            const MountReport& mount = stats.mounts[i];
+            response_stream << (i > 0 ? ", " : "") 
+                            << R"({"path": ")" << escape_json_string(mount.path) 
+                            << R"(", "type": ")" << escape_json_string(mount.fstype) 
+                            << R"(", "action": ")" << MountPolicies::action_name(mount.action) << R"("})";
+        }
+        response_stream << "]," << endl;
+        response_stream << R"(    "total_size": )" << stats.totals.size << "," << endl;
+        response_stream << R"(    "total_files": )" << stats.totals.file_count << "," << endl;
+        response_stream << R"(    "total_dirs": )" << stats.totals.dir_count << "," << endl;
+        response_stream << R"(    "totals_include_pruned": )" << (stats.totals.includes_pruned ? "true" : "false") << "," << endl;
+        response_stream << R"(    "pruned_size": )" << stats.pruned.size << "," << endl;
+        response_stream << R"(    "pruned_files": )" << stats.pruned.file_count << "," << endl;
+        response_stream << R"(    "pruned_dirs": )" << stats.pruned.dir_count << "," << endl;
         response_stream << R"(    "files": [)" << endl;
         
-        for (size_t i = 0; i < files.size(); ++i) {
-            const auto& file = files[i];
-            response_stream << R"(        {)" << endl;
-            // 转义文件名
-            response_stream << R"(            "name": ")" << escape_json_string(file.name) << R"(",)" << endl;
-            response_stream << R"(            "is_directory": )" << (file.is_directory ? "true" : "false") << "," << endl;
-            response_stream << R"(            "depth": )" << file.depth << "," << endl;
-            response_stream << R"(            "size": )" << file.size << "," << endl;
-            response_stream << R"(            "size_formatted": ")" << FileSystemScanner::format_file_size(file.size, options.human_readable) << R"(")" << endl;
-            response_stream << "        }";
-            if (i < files.size() - 1) response_stream << ",";
-            response_stream << endl;
+        // 条目逐个生成、边压缩边发送，不在内存中拼出整个响应（每个条目约200字节）
+        stream_response(req, res, "application/json; charset=utf-8", files.size() * 200, 
+            [head = response_stream.str(), scanned, options](const ResponseWriter& write) {
+                write(head);
+                
+                const ScanResult& files = *scanned;
+                char size_buffer[kSizeTextCapacity];
+                char time_buffer[kTimeTextCapacity];
+                string entry;
+                for (size_t i = 0; i < files.size(); ++i) {
+                    const bool is_directory = files.is_directory(i);
+                    const uintmax_t size = files.file_size(i);
+                    entry.clear();
+                    entry += "        {\n";
+                    // 转义文件名
+                    entry += "            \"name\": \"" + escape_json_string(files.name(i)) + "\",\n";
+                    entry += "            \"is_directory\": ";
+                    entry += is_directory ? "true,\n" : "false,\n";
+                    entry += "            \"depth\": " + to_string(files.depth(i)) + ",\n";
+                    entry += "            \"size\": " + to_string(size) + ",\n";
+                    if (files.omitted(i)) {
+                        // 未列出文件的汇总条目，file_count为其文件数
+                        entry += "            \"omitted\": true,\n";
+                        entry += "            \"file_count\": " + to_string(files.file_count(i)) + ",\n";
+                    }
+                    if (is_directory) {
+                        entry += "            \"file_count\": " + to_string(files.file_count(i)) + ",\n";
+                        entry += "            \"dir_count\": " + to_string(files.dir_count(i)) + ",\n";
+                        entry += "            \"includes_pruned\": ";
+                        entry += files.includes_pruned(i) ? "true,\n" : "false,\n";
+                    }
+                    if (!options.names_only) {
+                        entry += "            \"modified\": \"";
+                        entry += time_text(time_buffer, files.last_modified(i));
+                        entry += "\",\n";
+                    }
+                    entry += "            \"size_formatted\": \"";
+                    entry += size_text(size_buffer, size, options);
+                    entry += "\"\n";
+                    entry += i < files.size() - 1 ? "        },\n" : "        }\n";
+                    write(entry);
+                }
+                
+                write("    ]\n}");
+            });
+        
+    } catch (const exception& e) {
+        res.set_content(generate_json_response(false, "Scan error: " + string(e.what())), 
+                       "application/json");
+    }
+}
+
+void WebServer::handle_top(const httplib::Request& req, httplib::Response& res) {
+    try {
+        string json_error;
+        auto params = parse_simple_json(req.body, &json_error);
+        
+        if (!json_error.empty()) {
+            res.set_content(generate_json_response(false, "Invalid JSON request: " + json_error), 
+                           "application/json");
+            return;
         }
         
+        if (params.find("path") == params.end() || params["path"].empty()) {
+            res.set_content(generate_json_response(false, "Missing path parameter"), 
+                           "application/json");
+            return;
+        }
+        
+        string path_utf8 = params["path"];
+        FileTreeOptions options = parse_tree_options(req.body);
+        // 排名需要大小，名称只在入选时用到
+        options.names_only = false;
+        
+        size_t limit = 20;
+        if (params.find("limit") != params.end()) {
+            try {
+                limit = static_cast<size_t>(max(1, min(stoi(params["limit"]), 1000)));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        string client_id = scan_client_id(req, params);
+        auto token = make_shared<CancellationToken>();
+        options.cancel_token = token;
+        
+        // 流式扫描，不保留扫描结果，也不替换当前扫描
+        TopEntries top(limit);
+        ScanStats stats;
+        {
+            ScanRegistration registration(*this, client_id, token);
+            DisconnectWatcher watcher(req, token);
+            FileSystemScanner::scan_directory(path_utf8, options, top, &stats);
+        }
+        
+        char size_buffer[kSizeTextCapacity];
+        auto write_entries = [&](ostream& out, const vector<TopEntries::Entry>& entries, bool directories) {
+            for (size_t i = 0; i < entries.size(); i++) {
+                const TopEntries::Entry& entry = entries[i];
+                out << R"(        {"path": ")" << escape_json_string(entry.path) 
+                    << R"(", "size": )" << entry.size;
+                if (directories) {
+                    out << R"(, "file_count": )" << entry.file_count 
+                        << R"(, "dir_count": )" << entry.dir_count;
+                }
+                out << R"(, "size_formatted": ")" << size_text(size_buffer, entry.size, options) 
+                    << R"("})" << (i + 1 < entries.size() ? "," : "") << endl;
+            }
+        };
+        
+        ostringstream response_stream;
+        response_stream << R"({)" << endl;
+        response_stream << R"(    "success": true,)" << endl;
+        response_stream << R"(    "message": ")" 
+                        << (stats.truncated() ? "Scan stopped early, results are partial" : "Directory scanned successfully") 
+                        << R"(",)" << endl;
+        response_stream << R"(    "path": ")" << escape_json_string(path_utf8) << R"(",)" << endl;
+        response_stream << R"(    "limit": )" << limit << "," << endl;
+        response_stream << R"(    "truncated": )" << (stats.truncated() ? "true" : "false") << "," << endl;
+        response_stream << R"(    "truncated_reason": )" 
+                        << (stats.truncated() ? "\"" + string(scan_stop_reason(stats.stopped)) + "\"" : "null") 
+                        << "," << endl;
+        response_stream << R"(    "bytes_deduplicated": )" << stats.bytes_deduplicated << "," << endl;
+        response_stream << R"(    "total_size": )" << stats.totals.size << "," << endl;
+        response_stream << R"(    "total_files": )" << stats.totals.file_count << "," << endl;
+        response_stream << R"(    "total_dirs": )" << stats.totals.dir_count << "," << endl;
+        response_stream << R"(    "largest_files": [)" << endl;
+        write_entries(response_stream, top.largest_files(), false);
+        response_stream << R"(    ],)" << endl;
+        response_stream << R"(    "largest_directories": [)" << endl;
+        write_entries(response_stream, top.largest_directories(), true);
         response_stream << R"(    ])" << endl;
         response_stream << R"(})";
         
@@ -347,45 +759,364 @@ void WebServer::handle_scan(const httplib::Request& req, httplib::Response& res)
     }
 }
 
-void WebServer::handle_tree(const httplib::Request& req, httplib::Response& res) {
+void WebServer::handle_duplicates(const httplib::Request& req, httplib::Response& res) {
     try {
-        if (current_scan_.files.empty()) {
-            res.set_content(generate_json_response(false, "No scan data available. Please scan a directory first."), 
+        string json_error;
+        auto params = parse_simple_json(req.body, &json_error);
+        
+        if (!json_error.empty()) {
+            res.set_content(generate_json_response(false, "Invalid JSON request: " + json_error), 
+                           "application/json");
+            return;
+        }
+        
+        if (params.find("path") == params.end() || params["path"].empty()) {
+            res.set_content(generate_json_response(false, "Missing path parameter"), 
                            "application/json");
             return;
         }
         
-        // 生成文件树文本
-        string tree_text = FileSystemScanner::generate_tree_text(current_scan_.files, current_scan_.options);
+        string path_utf8 = params["path"];
+        FileTreeOptions options = parse_tree_options(req.body);
+        // 分组需要大小
+        options.names_only = false;
         
-        // 转义字符串中的特殊字符用于JSON
-        string escaped_tree = tree_text;
-        // 简单的转义：只转义引号和换行
-        size_t pos = 0;
-        while ((pos = escaped_tree.find('\\', pos)) != string::npos) {
-            escaped_tree.replace(pos, 1, "\\\\");
-            pos += 2;
+        DuplicateOptions duplicate_options;
+        if (params.find("hash_threads") != params.end()) {
+            try {
+                duplicate_options.threads = max(1, min(stoi(params["hash_threads"]), 64));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        if (params.find("min_size") != params.end()) {
+            try {
+                duplicate_options.min_size = max<uintmax_t>(1, stoull(params["min_size"]));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        if (params.find("verify") != params.end()) {
+            duplicate_options.verify = (params["verify"] == "true" || params["verify"] == "1");
         }
-        pos = 0;
-        while ((pos = escaped_tree.find('"', pos)) != string::npos) {
-            escaped_tree.replace(pos, 1, "\\\"");
-            pos += 2;
+        size_t limit = 100;
+        if (params.find("limit") != params.end()) {
+            try {
+                limit = static_cast<size_t>(max(1, min(stoi(params["limit"]), 10000)));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        // 扫描和读取文件共用一个取消标志
+        string client_id = scan_client_id(req, params);
+        auto token = make_shared<CancellationToken>();
+        options.cancel_token = token;
+        duplicate_options.cancel_token = token;
+        
+        ScanStats stats;
+        DuplicateStats duplicate_stats;
+        vector<DuplicateGroup> groups;
+        {
+            ScanRegistration registration(*this, client_id, token);
+            DisconnectWatcher watcher(req, token);
+            ScanResult files = FileSystemScanner::scan_directory(path_utf8, options, &stats);
+            groups = DuplicateFinder::find(files, duplicate_options, &duplicate_stats);
         }
-        pos = 0;
-        while ((pos = escaped_tree.find('\n', pos)) != string::npos) {
-            escaped_tree.replace(pos, 1, "\\n");
-            pos += 2;
+        
+        uintmax_t duplicate_files = 0;
+        for (const auto& group : groups) {
+            duplicate_files += group.paths.size();
         }
         
+        auto write_stage = [](ostream& out, const char* name, const DuplicateStats::Stage& stage, bool last) {
+            out << R"(        ")" << name << R"(": {"files": )" << stage.files 
+                << R"(, "bytes_read": )" << stage.bytes_read 
+                << R"(, "seconds": )" << fixed << setprecision(3) << stage.seconds 
+                << R"(, "gb_per_second": )" << stage.gigabytes_per_second() << defaultfloat 
+                << "}" << (last ? "" : ",") << endl;
+        };
+        
+        const bool partial = stats.truncated() || duplicate_stats.cancelled;
+        char size_buffer[kSizeTextCapacity];
         ostringstream response_stream;
         response_stream << R"({)" << endl;
         response_stream << R"(    "success": true,)" << endl;
-        response_stream << R"(    "tree_text": ")" << escaped_tree << R"(",)" << endl;
-        response_stream << R"(    "path": ")" << current_scan_.path << R"(",)" << endl;
-        response_stream << R"(    "file_count": )" << current_scan_.files.size() << endl;
+        response_stream << R"(    "message": ")" 
+                        << (partial ? "Scan stopped early, results are partial" : "Duplicates found successfully") 
+                        << R"(",)" << endl;
+        response_stream << R"(    "path": ")" << escape_json_string(path_utf8) << R"(",)" << endl;
+        response_stream << R"(    "truncated": )" << (partial ? "true" : "false") << "," << endl;
+        response_stream << R"(    "total_files": )" << stats.totals.file_count << "," << endl;
+        response_stream << R"(    "files_compared": )" << duplicate_stats.files_compared << "," << endl;
+        response_stream << R"(    "hard_links": )" << duplicate_stats.hard_links << "," << endl;
+        response_stream << R"(    "read_errors": )" << duplicate_stats.read_errors << "," << endl;
+        response_stream << R"(    "verified": )" << (duplicate_options.verify ? "true" : "false") << "," << endl;
+        response_stream << R"(    "group_count": )" << groups.size() << "," << endl;
+        response_stream << R"(    "duplicate_files": )" << duplicate_files << "," << endl;
+        response_stream << R"(    "reclaimable_bytes": )" << duplicate_stats.reclaimable_bytes << "," << endl;
+        response_stream << R"(    "reclaimable_formatted": ")" 
+                        << size_text(size_buffer, duplicate_stats.reclaimable_bytes, options) 
+                        << R"(",)" << endl;
+        response_stream << R"(    "stages": {)" << endl;
+        write_stage(response_stream, "sample", duplicate_stats.sample, false);
+        write_stage(response_stream, "full", duplicate_stats.full, false);
+        write_stage(response_stream, "verify", duplicate_stats.verify, true);
+        response_stream << R"(    },)" << endl;
+        response_stream << R"(    "groups": [)" << endl;
+        
+        // 只返回可释放字节数最多的limit组
+        const size_t shown = min(limit, groups.size());
+        for (size_t i = 0; i < shown; i++) {
+            const DuplicateGroup& group = groups[i];
+            response_stream << R"(        {"size": )" << group.size 
+                            << R"(, "hash": ")" << group.hash 
+                            << R"(", "reclaimable": )" << group.reclaimable() 
+                            << R"(, "paths": [)";
+            for (size_t k = 0; k < group.paths.size(); k++) {
+                response_stream << (k > 0 ? ", " : "") << "\"" << escape_json_string(group.paths[k]) << "\"";
+            }
+            response_stream << "]}" << (i + 1 < shown ? "," : "") << endl;
+        }
+        
+        response_stream << R"(    ])" << endl;
         response_stream << R"(})";
         
-        res.set_content(response_stream.str(), "application/json");
+        res.set_content(response_stream.str(), "application/json; charset=utf-8");
+        
+    } catch (const exception& e) {
+        res.set_content(generate_json_response(false, "Duplicate search error: " + string(e.what())), 
+                       "application/json");
+    }
+}
+
+void WebServer::handle_scan_cancel(const httplib::Request& req, httplib::Response& res) {
+    auto params = parse_simple_json(req.body);
+    string client_id = scan_client_id(req, params);
+    
+    shared_ptr<CancellationToken> token;
+    {
+        lock_guard<mutex> lock(scans_mutex_);
+        auto it = active_scans_.find(client_id);
+        if (it != active_scans_.end()) {
+            token = it->second;
+            active_scans_.erase(it);
+        }
+    }
+    
+    if (token) {
+        token->cancel();
+        res.set_content(generate_json_response(true, "Scan cancelled"), "application/json");
+    } else {
+        res.set_content(generate_json_response(true, "No scan in progress"), "application/json");
+    }
+}
+
+string WebServer::scan_client_id(const httplib::Request& req, map<string, string>& params) {
+    auto it = params.find("client_id");
+    if (it != params.end() && !it->second.empty()) {
+        return it->second;
+    }
+    return req.remote_addr;
+}
+
+void WebServer::begin_scan(const string& client_id, const shared_ptr<CancellationToken>& token) {
+    shared_ptr<CancellationToken> previous;
+    {
+        lock_guard<mutex> lock(scans_mutex_);
+        auto& slot = active_scans_[client_id];
+        previous = std::move(slot);
+        slot = token;
+    }
+    if (previous) {
+        previous->cancel();
+    }
+}
+
+void WebServer::end_scan(const string& client_id, const shared_ptr<CancellationToken>& token) {
+    lock_guard<mutex> lock(scans_mutex_);
+    auto it = active_scans_.find(client_id);
+    if (it != active_scans_.end() && it->second == token) {
+        active_scans_.erase(it);
+    }
+}
+
+shared_ptr<const ScanSnapshot> WebServer::find_snapshot(const string& root) {
+    lock_guard<mutex> lock(scans_mutex_);
+    auto it = snapshots_.find(root);
+    if (it == snapshots_.end()) {
+        return nullptr;
+    }
+    it->second.last_used = ++snapshot_clock_;
+    return it->second.snapshot;
+}
+
+void WebServer::store_snapshot(const string& root, 
+                               shared_ptr<const ScanSnapshot> snapshot, 
+                               shared_ptr<LiveIndex> live) {
+    // 被替换或淘汰的条目在锁外析构（停止监视线程）
+    vector<SnapshotEntry> removed;
+    lock_guard<mutex> lock(scans_mutex_);
+    if (snapshots_.find(root) == snapshots_.end() && snapshots_.size() >= kMaxSnapshots) {
+        // 淘汰最久未使用的根目录
+        auto oldest = min_element(snapshots_.begin(), snapshots_.end(), [](const auto& a, const auto& b) {
+            return a.second.last_used < b.second.last_used;
+        });
+        removed.push_back(std::move(oldest->second));
+        snapshots_.erase(oldest);
+    }
+    SnapshotEntry& entry = snapshots_[root];
+    removed.push_back(std::move(entry));
+    entry = {std::move(snapshot), std::move(live), ++snapshot_clock_};
+}
+
+shared_ptr<LiveIndex> WebServer::find_live_index(const string& root, const FileTreeOptions& options) {
+    lock_guard<mutex> lock(scans_mutex_);
+    auto it = snapshots_.find(root);
+    if (it == snapshots_.end() || !it->second.live || !it->second.live->compatible(root, options)) {
+        return nullptr;
+    }
+    it->second.last_used = ++snapshot_clock_;
+    return it->second.live;
+}
+
+WebServer::CurrentScan WebServer::current_scan() {
+    CurrentScan scan;
+    {
+        lock_guard<mutex> lock(current_mutex_);
+        scan = current_scan_;
+    }
+    if (!scan.files) {
+        return scan;
+    }
+    // 查询索引时不持有current_mutex_；其间当前扫描已被换掉时不覆盖
+    if (shared_ptr<LiveIndex> live = find_live_index(scan.path, scan.options)) {
+        shared_ptr<const ScanSnapshot> snapshot = live->query();
+        shared_ptr<const ScanResult> files(snapshot, &snapshot->result());
+        lock_guard<mutex> lock(current_mutex_);
+        if (current_scan_.files == scan.files) {
+            current_scan_.files = files;
+        }
+        scan.files = std::move(files);
+    }
+    return scan;
+}
+
+void WebServer::set_current_scan(CurrentScan scan) {
+    lock_guard<mutex> lock(current_mutex_);
+    current_scan_ = std::move(scan);
+}
+
+fs::path WebServer::snapshot_file_path(const string& root) const {
+    // 按根目录路径的FNV-1a散列命名
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : root) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    ostringstream name;
+    name << hex << setw(16) << setfill('0') << hash << ".snap";
+    return fs::path(snapshot_dir_) / name.str();
+}
+
+void WebServer::persist_snapshot(shared_ptr<const ScanSnapshot> snapshot, const FileTreeOptions& options) {
+    fs::path file = snapshot_file_path(snapshot->root());
+    
+    // 一次只写一个文件；写入在后台进行，不延迟响应
+    lock_guard<mutex> lock(persist_mutex_);
+    if (persist_thread_.joinable()) {
+        persist_thread_.join();
+    }
+    persist_thread_ = thread([snapshot = std::move(snapshot), options, file]() {
+        SnapshotFile::write(file, *snapshot, options);
+    });
+}
+
+void WebServer::load_saved_snapshots() {
+    // 按修改时间从旧到新加载最近的kMaxSnapshots个，最新的作为当前扫描
+    vector<pair<fs::file_time_type, fs::path>> files;
+    for (const auto& entry : fs::directory_iterator(snapshot_dir_)) {
+        if (entry.path().extension() == ".snap" && entry.is_regular_file()) {
+            files.emplace_back(entry.last_write_time(), entry.path());
+        }
+    }
+    sort(files.begin(), files.end());
+    if (files.size() > kMaxSnapshots) {
+        files.erase(files.begin(), files.end() - kMaxSnapshots);
+    }
+    
+    for (const auto& file : files) {
+        auto start = chrono::steady_clock::now();
+        FileTreeOptions options;
+        shared_ptr<const ScanSnapshot> snapshot = SnapshotFile::load(file.second, &options);
+        if (!snapshot) {
+            continue;
+        }
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        cout << "Loaded snapshot of " << snapshot->root() << " (" << snapshot->result().size() 
+             << " entries) in " << elapsed.count() << " ms" << endl;
+        
+        if (snapshot->complete()) {
+            store_snapshot(snapshot->root(), snapshot);
+        }
+        set_current_scan({snapshot->root(), shared_ptr<const ScanResult>(snapshot, &snapshot->result()), options});
+    }
+}
+
+void WebServer::handle_tree(const httplib::Request& req, httplib::Response& res) {
+    try {
+        // 监视中的根目录：取索引的最新结果
+        const CurrentScan scan = current_scan();
+        
+        if (!scan.files || scan.files->empty()) {
+            res.set_content(generate_json_response(false, "No scan data available. Please scan a directory first."), 
+                           "application/json");
+            return;
+        }
+        
+        // 输出格式：{"format": "ascii"}，默认为emoji
+        TreeFormat format = TreeFormat::Emoji;
+        auto params = parse_simple_json(req.body);
+        if (params.find("format") != params.end() && !parse_tree_format(params["format"], format)) {
+            res.set_content(generate_json_response(false, "Unknown format: " + params["format"] + 
+                                                   " (expected one of: " + kTreeFormatList + ")"),
+                           "application/json");
+            return;
+        }
+        
+        // 渲染范围：子树、深度和分页（见parse_tree_window）
+        TreeWindow window;
+        string error;
+        if (!parse_tree_window(*scan.files, params, window, error)) {
+            res.set_content(generate_json_response(false, error), "application/json");
+            return;
+        }
+        
+        // 生成文件树文本：边渲染边转义为JSON字符串、边压缩边发送（每个条目一行，约40字节）
+        check_tree_window(*scan.files, format, window);
+        const ScanResult& files = *scan.files;
+        size_t lines = window.subtree == TreeWindow::kNone ? files.size() 
+                                                           : files.subtree_end(window.subtree) - window.subtree - 1;
+        if (window.limit > 0) {
+            lines = min(lines, window.limit);
+        }
+        stream_response(req, res, "application/json", lines * 40, 
+            [files = scan.files, options = scan.options, path = scan.path, 
+             format, window](const ResponseWriter& write) {
+                write("{\n    \"success\": true,\n    \"tree_text\": \"");
+                // 转义字符串中的特殊字符用于JSON（一次遍历；逐个replace在每个换行处都要移动其后的全部文本）
+                const TreeSlice slice = write_tree(*files, options, format, window, 
+                                                   [&write](string_view chunk) { write(escape_json_string(chunk)); });
+                
+                string tail = "\",\n";
+                tail += "    \"format\": \"" + string(tree_format_name(format)) + "\",\n";
+                tail += "    \"path\": \"" + path + "\",\n";
+                tail += "    \"lines\": " + to_string(slice.lines) + ",\n";
+                tail += "    \"next_cursor\": " +
+                        (slice.next_cursor == TreeWindow::kNone ? string("null") : to_string(slice.next_cursor)) + ",\n";
+                tail += "    \"file_count\": " + to_string(files->size()) + "\n";
+                tail += "}";
+                write(tail);
+            });
         
     } catch (const exception& e) {
         res.set_content(generate_json_response(false, "Tree generation error: " + string(e.what())), 
@@ -395,21 +1126,60 @@ void WebServer::handle_tree(const httplib::Request& req, httplib::Response& res)
 
 void WebServer::handle_download(const httplib::Request& req, httplib::Response& res) {
     try {
-        if (current_scan_.files.empty()) {
+        // 监视中的根目录：取索引的最新结果
+        const CurrentScan scan = current_scan();
+        
+        if (!scan.files || scan.files->empty()) {
             res.set_content("No scan data available. Please scan a directory first.", 
                            "text/plain");
             return;
         }
         
-        // 生成文件树文本
-        string tree_text = FileSystemScanner::generate_tree_text(current_scan_.files, current_scan_.options);
+        // 输出格式：?format=csv，默认为emoji
+        TreeFormat format = TreeFormat::Emoji;
+        if (req.has_param("format") && !parse_tree_format(req.get_param_value("format"), format)) {
+            res.set_content("Unknown format: " + req.get_param_value("format") + 
+                           " (expected one of: " + kTreeFormatList + ")", "text/plain");
+            return;
+        }
         
-        // 设置下载头
-        string filename = "file_tree_" + to_string(time(nullptr)) + ".txt";
-        res.set_header("Content-Type", "text/plain");
-        res.set_header("Content-Disposition", "attachment; filename=" + filename);
+        // 渲染范围：与/api/tree相同的参数
+        map<string, string> params;
+        for (const char* name : {"subtree", "index", "depth", "offset", "limit", "cursor"}) {
+            if (req.has_param(name)) {
+                params[name] = req.get_param_value(name);
+            }
+        }
+        TreeWindow window;
+        string error;
+        if (!parse_tree_window(*scan.files, params, window, error)) {
+            res.set_content(error, "text/plain");
+            return;
+        }
         
-        res.set_content(tree_text, "text/plain");
+        // 先检查渲染范围，出错时返回的是错误信息而不是下载的文件
+        check_tree_window(*scan.files, format, window);
+        string filename = "file_tree_" + to_string(time(nullptr)) + tree_file_extension(format);
+        
+        // 分页时下一段的起点要放在响应头里，先渲染（一页的大小有限），渲染完再设置下载头
+        if (window.limit > 0) {
+            string tree_text;
+            const TreeSlice slice = write_tree(*scan.files, scan.options, format, window,
+                                               [&tree_text](string_view chunk) { tree_text.append(chunk); });
+            res.set_header("Content-Disposition", "attachment; filename=" + filename);
+            if (slice.next_cursor != TreeWindow::kNone) {
+                res.set_header("X-Next-Cursor", to_string(slice.next_cursor));
+            }
+            res.set_content(std::move(tree_text), tree_content_type(format));
+            return;
+        }
+        
+        // 整个树：边渲染边压缩边发送
+        res.set_header("Content-Disposition", "attachment; filename=" + filename);
+        stream_response(req, res, tree_content_type(format), scan.files->size() * 40, 
+            [files = scan.files, options = scan.options, format, window](const ResponseWriter& write) {
+                write_tree(*files, options, format, window, write);
+            });
         
     } catch (const exception& e) {
         res.set_content("Error generating download: " + string(e.what()), "text/plain");
@@ -427,8 +1197,11 @@ void WebServer::handle_api_info(const httplib::Request& req, httplib::Response&
         {"method": "GET", "path": "/", "description": "Frontend interface"},
         {"method": "POST", "path": "/api/upload", "description": "Upload files/folders"},
         {"method": "POST", "path": "/api/scan", "description": "Scan directory"},
-        {"method": "POST", "path": "/api/tree", "description": "Generate file tree"},
-        {"method": "GET", "path": "/api/download/tree", "description": "Download file tree as text"},
+        {"method": "POST", "path": "/api/top", "description": "Largest files and directories under a directory"},
+        {"method": "POST", "path": "/api/duplicates", "description": "Find files with identical content"},
+        {"method": "POST", "path": "/api/scan/cancel", "description": "Cancel the client's scan in progress"},
+        {"method": "POST", "path": "/api/tree", "description": "Generate file tree; format: emoji, ascii, unicode, markdown, json, ndjson, csv; subtree, depth, offset, limit, cursor select a part"},
+        {"method": "GET", "path": "/api/download/tree", "description": "Download file tree; ?format=, ?subtree= etc. as for /api/tree"},
         {"method": "GET", "path": "/api/info", "description": "API information"}
     ],
     "status": ")" + status + R"(",
@@ -442,7 +1215,11 @@ FileTreeOptions WebServer::parse_tree_options(const std::string& json_str) {
     FileTreeOptions options;
     
     try {
-        auto params = parse_simple_json(json_str);
+        JsonDocument document;
+        if (!document.parse(json_str)) {
+            return options;
+        }
+        auto params = json_params(document);
         
         // 解析布尔值
         if (params.find("show_size") != params.end()) {
@@ -453,6 +1230,56 @@ FileTreeOptions WebServer::parse_tree_options(const std::string& json_str) {
             options.human_readable = (params["human_readable"] == "true" || params["human_readable"] == "1");
         }
         
+        // 人类可读大小："size_units": "si"（1000进制）或"binary"（默认），"size_precision": 0-6
+        if (params.find("size_units") != params.end()) {
+            if (params["size_units"] == "si") {
+                options.size_units = SizeUnits::SI;
+            } else if (params["size_units"] == "binary") {
+                options.size_units = SizeUnits::Binary;
+            }
+        }
+        
+        if (params.find("size_precision") != params.end()) {
+            try {
+                options.size_precision = max(0, min(stoi(params["size_precision"]), kMaxSizePrecision));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        if (params.find("count_pruned") != params.end()) {
+            options.count_pruned = (params["count_pruned"] == "true" || params["count_pruned"] == "1");
+        }
+        
+        if (params.find("names_only") != params.end()) {
+            options.names_only = (params["names_only"] == "true" || params["names_only"] == "1");
+        }
+        
+        if (params.find("follow_symlinks") != params.end()) {
+            options.follow_symlinks = (params["follow_symlinks"] == "true" || params["follow_symlinks"] == "1");
+        }
+        
+        if (params.find("count_hardlinks_once") != params.end()) {
+            options.count_hardlinks_once = (params["count_hardlinks_once"] == "true" || params["count_hardlinks_once"] == "1");
+        }
+        
+        if (params.find("one_filesystem") != params.end()) {
+            options.one_filesystem = (params["one_filesystem"] == "true" || params["one_filesystem"] == "1");
+        }
+        
+        // 挂载点规则：数组，或逗号分隔的字符串，如 "pseudo=skip, nfs4=throttle"
+        if (params.find("mount_policies") != params.end()) {
+            istringstream rules(params["mount_policies"]);
+            string rule;
+            while (getline(rules, rule, ',')) {
+                const size_t first = rule.find_first_not_of(" \t");
+                if (first != string::npos) {
+                    options.mount_policies.push_back(rule.substr(first, rule.find_last_not_of(" \t") - first + 1));
+                }
+            }
+        }
+        append_strings(document, document.find(0, "mount_policies"), options.mount_policies);
+        
         if (params.find("max_depth") != params.end()) {
             try {
                 options.max_depth = stoi(params["max_depth"]);
@@ -461,10 +1288,87 @@ FileTreeOptions WebServer::parse_tree_options(const std::string& json_str) {
             }
         }
         
-        // 解析排除模式（简化版，假设单个值）
+        if (params.find("threads") != params.end()) {
+            try {
+                // 限制每个请求的扫描线程数
+                options.threads = max(1, min(stoi(params["threads"]), 64));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        if (params.find("backend") != params.end()) {
+            if (params["backend"] == "getdents") {
+                options.backend = ScanBackend::Getdents;
+            } else if (params["backend"] == "io_uring") {
+                options.backend = ScanBackend::IoUring;
+            } else if (params["backend"] == "std") {
+                options.backend = ScanBackend::StdFilesystem;
+            }
+        }
+        
+        if (params.find("sort") != params.end()) {
+            const string& sort = params["sort"];
+            if (sort == "name") {
+                options.sort_order = SortOrder::Name;
+            } else if (sort == "name_nocase") {
+                options.sort_order = SortOrder::NameNoCase;
+            } else if (sort == "natural") {
+                options.sort_order = SortOrder::Natural;
+            } else if (sort == "size") {
+                options.sort_order = SortOrder::SizeDesc;
+            } else if (sort == "mtime") {
+                options.sort_order = SortOrder::MtimeDesc;
+            }
+        }
+        
+        if (params.find("max_open_dirs") != params.end()) {
+            try {
+                options.max_open_dirs = max(0, stoi(params["max_open_dirs"]));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        if (params.find("io_queue_depth") != params.end()) {
+            try {
+                options.io_queue_depth = max(1, min(stoi(params["io_queue_depth"]), 4096));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        if (params.find("time_limit_ms") != params.end()) {
+            try {
+                options.time_limit_ms = max(0, stoi(params["time_limit_ms"]));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        if (params.find("max_entries") != params.end()) {
+            try {
+                options.max_entries = stoull(params["max_entries"]);
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        // 每个目录最多列出的条目数，其余文件合为一行汇总
+        if (params.find("max_children_per_dir") != params.end()) {
+            try {
+                const unsigned long long limit = stoull(params["max_children_per_dir"]);
+                options.max_children_per_dir = static_cast<uint32_t>(min<unsigned long long>(limit, UINT32_MAX));
+            } catch (...) {
+                // 使用默认值
+            }
+        }
+        
+        // 排除模式：字符串数组（前端发送的形式），也接受单个字符串
         if (params.find("exclude_patterns") != params.end()) {
             options.exclude_patterns.push_back(params["exclude_patterns"]);
         }
+        append_strings(document, document.find(0, "exclude_patterns"), options.exclude_patterns);
         
     } catch (...) {
         // 使用默认选项
@@ -492,33 +1396,59 @@ std::string WebServer::generate_json_response(bool success,
     return response.str();
 }
 
-std::map<std::string, std::string> WebServer::parse_simple_json(const std::string& json_str) {
-    std::map<std::string, std::string> result;
-    
-    if (json_str.empty() || json_str[0] != '{') {
-        return result;
+void WebServer::compress_response(const httplib::Request& req, httplib::Response& res) {
+    // 静态文件和分块发送的响应没有body；带Content-Range的是原文的一段
+    if (res.body.size() < compression_.min_size || res.has_header("Content-Encoding") || 
+        res.has_header("Content-Range") || !is_compressible_type(res.get_header_value("Content-Type"))) {
+        return;
     }
-    
-    // 简单的JSON解析器 - 只处理字符串值的键值对
-    string content = json_str.substr(1);  // 跳过开始的 {
-    
-    // 查找所有的 "key": "value" 对
-    regex pattern("\\\"([^\\\"]+)\\\"\\s*:\\s*\\\"([^\\\"]*)\\\"");
-    
-    smatch match;
-    string::const_iterator searchStart(content.cbegin());
-    while (regex_search(searchStart, content.cend(), match, pattern)) {
-        result[match[1].str()] = match[2].str();
-        searchStart = match.suffix().first;
+    res.set_header("Vary", "Accept-Encoding");
+    const ContentEncoding encoding = negotiate_encoding(req.get_header_value("Accept-Encoding"), compression_);
+    if (encoding == ContentEncoding::Identity) {
+        return;
     }
     
-    // 也支持布尔值和数字
-    regex bool_pattern("\\\"([^\\\"]+)\\\"\\s*:\\s*(true|false|null|-?\\d+\\.?\\d*)");
-    searchStart = content.cbegin();
-    while (regex_search(searchStart, content.cend(), match, bool_pattern)) {
-        result[match[1].str()] = match[2].str();
-        searchStart = match.suffix().first;
+    res.body = compress_string(res.body, encoding, compression_);
+    // Content-Length已按原文设置（headers可以有重复的键，set_header不会替换）
+    res.headers.erase("Content-Length");
+    res.set_header("Content-Length", to_string(res.body.size()));
+    res.set_header("Content-Encoding", content_encoding_name(encoding));
+}
+
+void WebServer::stream_response(const httplib::Request& req, httplib::Response& res, 
+                                const char* content_type, size_t size_hint, 
+                                function<void(const ResponseWriter&)> produce) {
+    ContentEncoding encoding = ContentEncoding::Identity;
+    if (size_hint >= compression_.min_size) {
+        res.set_header("Vary", "Accept-Encoding");
+        encoding = negotiate_encoding(req.get_header_value("Accept-Encoding"), compression_);
+    }
+    if (encoding != ContentEncoding::Identity) {
+        res.set_header("Content-Encoding", content_encoding_name(encoding));
     }
     
-    return result;
+    const CompressionSettings settings = compression_;
+    res.set_chunked_content_provider(content_type, 
+        [encoding, settings, produce = std::move(produce)](size_t, httplib::DataSink& sink) {
+            auto compressor = ResponseCompressor::create(encoding, settings, [&sink](const char* data, size_t length) {
+                return sink.write(data, length);
+            });
+            try {
+                produce([&compressor](string_view chunk) { compressor->write(chunk); });
+            } catch (const exception& e) {
+                // 响应头已经发出，只能截断响应
+                cerr << "Error while streaming response: " << e.what() << endl;
+            }
+            compressor->finish();
+            sink.done();
+            return true;
+        });
+}
+
+std::map<std::string, std::string> WebServer::parse_simple_json(const std::string& json_str, std::string* error) {
+    JsonDocument document;
+    if (!document.parse(json_str, error)) {
+        return {};
+    }
+    return json_params(document);
 }
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "filesystem.hpp"
+#include "scan_result.hpp"
+#include "scan_snapshot.hpp"
+#include "live_index.hpp"
+#include "snapshot_file.hpp"
+#include "response_compression.hpp"
 #include "httplib.h"
+#include <functional>
 #include <string>
 #include <memory>
 #include <thread>
 #include <atomic>
 #include <map>
+#include <mutex>
 
 class WebServer {
 public:
@@ -25,6 +32,9 @@ public:
     // 获取服务器端口
     int get_port() const { return port_; }
     
+    // 响应压缩的级别和最小大小（在start之前设置）
+    void set_compression(const CompressionSettings& settings) { compression_ = settings; }
+    
 private:
     // 设置路由
     void setup_routes();
@@ -33,21 +43,68 @@ private:
     void handle_root(const httplib::Request& req, httplib::Response& res);
     void handle_upload(const httplib::Request& req, httplib::Response& res);
     void handle_scan(const httplib::Request& req, httplib::Response& res);
+    void handle_top(const httplib::Request& req, httplib::Response& res);
+    void handle_duplicates(const httplib::Request& req, httplib::Response& res);
+    void handle_scan_cancel(const httplib::Request& req, httplib::Response& res);
     void handle_tree(const httplib::Request& req, httplib::Response& res);
     void handle_download(const httplib::Request& req, httplib::Response& res);
     void handle_api_info(const httplib::Request& req, httplib::Response& res);
     
-    // 解析JSON请求（简化版）
+    // 发起扫描的客户端：请求中的client_id，没有时使用客户端地址
+    std::string scan_client_id(const httplib::Request& req, std::map<std::string, std::string>& params);
+    
+    // 登记客户端的扫描（取消该客户端仍在进行的上一次扫描）/ 扫描结束后注销
+    void begin_scan(const std::string& client_id, const std::shared_ptr<CancellationToken>& token);
+    void end_scan(const std::string& client_id, const std::shared_ptr<CancellationToken>& token);
+    // 在作用域内登记扫描：构造时begin_scan，析构时end_scan（扫描抛出异常时也会注销）
+    class ScanRegistration;
+    
+    // 增量扫描的快照和实时索引（按根目录，最多保留kMaxSnapshots个）
+    std::shared_ptr<const ScanSnapshot> find_snapshot(const std::string& root);
+    void store_snapshot(const std::string& root, 
+                        std::shared_ptr<const ScanSnapshot> snapshot, 
+                        std::shared_ptr<LiveIndex> live = nullptr);
+    std::shared_ptr<LiveIndex> find_live_index(const std::string& root, const FileTreeOptions& options);
+    
+    // 当前扫描的目录信息
+    struct CurrentScan {
+        std::string path;
+        std::shared_ptr<const ScanResult> files;
+        FileTreeOptions options;
+    };
+    
+    // 当前扫描的副本，请求处理只使用副本；根目录被监视时换成索引的最新结果（并更新当前扫描）
+    CurrentScan current_scan();
+    void set_current_scan(CurrentScan scan);
+    
+    // 快照文件：完整扫描后在后台写入，启动时加载（最近的一个作为当前扫描）
+    fs::path snapshot_file_path(const std::string& root) const;
+    void persist_snapshot(std::shared_ptr<const ScanSnapshot> snapshot, const FileTreeOptions& options);
+    void load_saved_snapshots();
+    
+    // 解析请求中的扫描选项（数组选项如exclude_patterns直接从JSON文档读取）
     FileTreeOptions parse_tree_options(const std::string& json_str);
     
-    // 解析简单JSON
-    std::map<std::string, std::string> parse_simple_json(const std::string& json_str);
+    // 请求对象的顶层标量值：字符串已解码，数字、布尔值和null为原文。
+    // 不是合法的JSON时返回空，error（如给出）为原因
+    std::map<std::string, std::string> parse_simple_json(const std::string& json_str, std::string* error = nullptr);
     
     // 生成JSON响应
     std::string generate_json_response(bool success, 
                                       const std::string& message = "", 
                                       const std::string& data = "");
     
+    // 路由处理之后：按Accept-Encoding压缩已生成的响应体（太小、已压缩或不是文本的不压缩）
+    void compress_response(const httplib::Request& req, httplib::Response& res);
+    
+    // 边生成边发送（分块传输）：produce把响应体分段交给write，按Accept-Encoding边压缩边发送。
+    // size_hint为响应体的估计大小，小于最小压缩大小时不压缩。
+    // produce在发送时才运行，请求中的参数须事先检查并按值捕获
+    using ResponseWriter = std::function<void(std::string_view)>;
+    void stream_response(const httplib::Request& req, httplib::Response& res, 
+                         const char* content_type, size_t size_hint, 
+                         std::function<void(const ResponseWriter&)> produce);
+    
     // 服务器实例
     std::unique_ptr<httplib::Server> server_;
     std::unique_ptr<std::thread> server_thread_;
@@ -55,14 +112,30 @@ private:
     // 服务器状态
     std::atomic<bool> running_{false};
     int port_{8080};
+    CompressionSettings compression_;
     
     // 上传文件存储目录
     std::string upload_dir_{"uploads"};
     
-    // 当前扫描的目录信息
-    struct {
-        std::string path;
-        std::vector<FileInfo> files;
-        FileTreeOptions options;
-    } current_scan_;
+    // 快照文件目录；persist_thread_为正在进行的写入，由persist_mutex_保护
+    std::string snapshot_dir_{"snapshots"};
+    std::mutex persist_mutex_;
+    std::thread persist_thread_;
+    
+    // 进行中的扫描（按客户端）、增量扫描快照和实时索引，由scans_mutex_保护
+    struct SnapshotEntry {
+        std::shared_ptr<const ScanSnapshot> snapshot;
+        std::shared_ptr<LiveIndex> live;  // 监视中时不为空
+        uint64_t last_used = 0;
+    };
+    static constexpr size_t kMaxSnapshots = 8;
+    
+    std::mutex scans_mutex_;
+    std::map<std::string, std::shared_ptr<CancellationToken>> active_scans_;
+    std::map<std::string, SnapshotEntry> snapshots_;
+    uint64_t snapshot_clock_ = 0;
+    
+    // 当前扫描，由current_mutex_保护（各个请求在不同的线程中处理）
+    std::mutex current_mutex_;
+    CurrentScan current_scan_;
 };
\ No newline at end of file
@@ -4,6 +4,10 @@ class FileManagerApp {
         this.currentFiles = [];
         this.currentPath = '';
         this.totalSize = 0;
+        // Identifies this tab's scans so the server can cancel a superseded one
+        this.clientId = (window.crypto && crypto.randomUUID)
+            ? crypto.randomUUID()
+            : `${Date.now()}-${Math.random().toString(36).slice(2)}`;
         
         this.initElements();
         this.initEventListeners();
@@ -65,6 +69,12 @@ class FileManagerApp {
             }
         });
 
+        // Stop the server-side walk when the tab goes away
+        window.addEventListener('pagehide', () => {
+            navigator.sendBeacon(`${this.apiBaseUrl}/api/scan/cancel`,
+                JSON.stringify({ client_id: this.clientId }));
+        });
+
         // Save settings when changed
         [this.showSizeCheckbox, this.maxDepthInput, this.excludePatternsInput].forEach(el => {
             el.addEventListener('change', () => this.saveState());
@@ -93,6 +103,7 @@ class FileManagerApp {
                 },
                 body: JSON.stringify({
                     path: path,
+                    client_id: this.clientId,
                     ...options
                 })
             });
@@ -107,14 +118,20 @@ class FileManagerApp {
                 this.currentPathElement.textContent = this.currentPath;
                 this.fileCountElement.textContent = result.file_count || 0;
                 
-                // Calculate total size
-                this.totalSize = this.currentFiles.reduce((sum, file) => sum + (file.size || 0), 0);
+                // Total size is rolled up by the server; fall back to summing files
+                this.totalSize = (result.total_size !== undefined)
+                    ? result.total_size
+                    : this.currentFiles.reduce((sum, file) => sum + (file.is_directory ? 0 : (file.size || 0)), 0);
                 this.totalSizeElement.textContent = this.formatFileSize(this.totalSize);
                 
                 // Update file table
                 this.updateFileTable();
                 
-                this.showToast(`Found ${result.file_count} files/directories`, 'success');
+                if (result.truncated) {
+                    this.showToast(`Scan stopped early (${result.truncated_reason}), showing ${result.file_count} files/directories`, 'warning');
+                } else {
+                    this.showToast(`Found ${result.file_count} files/directories`, 'success');
+                }
                 
                 // Auto generate tree if requested
                 if (autoGenerate) {
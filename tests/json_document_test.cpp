@@ -0,0 +1,143 @@
+// JsonDocument的测试：结构、转义、嵌套限制、重复键和错误位置
+#include "json_document.hpp"
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static void test_structure() {
+    JsonDocument document;
+    CHECK(document.parse(R"( {"a": [1, -2.5e3, "x", true, null, {"b": []}], "c": {}} )"));
+    CHECK(document.size() == 10);
+    CHECK(document.type(0) == JsonType::Object && document.end(0) == 10);
+
+    const size_t a = document.find(0, "a");
+    CHECK(a == 1 && document.type(a) == JsonType::Array && document.end(a) == 9);
+    CHECK(document.type(2) == JsonType::Number && document.text(2) == "1");
+    CHECK(document.type(3) == JsonType::Number && document.text(3) == "-2.5e3");
+    CHECK(document.type(4) == JsonType::String && document.text(4) == "x");
+    CHECK(document.is_true(5));
+    CHECK(document.type(6) == JsonType::Null);
+    CHECK(document.type(7) == JsonType::Object && document.find(7, "b") == 8);
+    CHECK(document.type(8) == JsonType::Array && document.end(8) == 9);
+    CHECK(document.find(0, "c") == 9 && document.type(9) == JsonType::Object);
+
+    // 直接子值的遍历
+    size_t children = 0;
+    for (size_t i = a + 1; i < document.end(a); i = document.end(i)) {
+        children++;
+    }
+    CHECK(children == 6);
+
+    CHECK(document.find(0, "missing") == JsonDocument::kNotFound);
+    CHECK(document.find(a, "a") == JsonDocument::kNotFound);  // 不是对象
+    CHECK(document.key(a) == "a" && document.key(2).empty());
+
+    CHECK(document.parse("0") && document.type(0) == JsonType::Number);
+    CHECK(document.parse("-0.0E+1") && document.text(0) == "-0.0E+1");
+    CHECK(document.parse(" \"\" ") && document.text(0).empty());
+    CHECK(document.parse("[]") && document.size() == 1 && document.end(0) == 1);
+}
+
+static void test_strings() {
+    JsonDocument document;
+    CHECK(document.parse(R"({"p": "C:\\Users\\\u5f20\u4e09\/x\n\t\"q\"", "raw": "中文 ✓"})"));
+    CHECK(document.text(document.find(0, "p")) == "C:\\Users\\张三/x\n\t\"q\"");
+    CHECK(document.text(document.find(0, "raw")) == "中文 ✓");
+
+    // 代理对合成一个码点，单独的代理项换成U+FFFD
+    CHECK(document.parse(R"(["\ud83d\ude00", "\uD83D\uDE00", "\ud800x", "\udc00", "\ud800\u0041"])"));
+    CHECK(document.text(1) == "😀");
+    CHECK(document.text(2) == "😀");
+    CHECK(document.text(3) == "\xEF\xBF\xBDx");
+    CHECK(document.text(4) == "\xEF\xBF\xBD");
+    CHECK(document.text(5) == "\xEF\xBF\xBD" "A");
+
+    // 解码后的字符串在之后的字符串解码时仍然有效
+    CHECK(document.parse(R"(["a\nb", "plain", "c\\d"])"));
+    CHECK(document.text(1) == "a\nb" && document.text(2) == "plain" && document.text(3) == "c\\d");
+}
+
+static void test_duplicate_keys() {
+    JsonDocument document;
+    CHECK(document.parse(R"({"key": 1, "k\u0065y": 2, "other": 3, "key": 4})"));
+    CHECK(document.text(document.find(0, "key")) == "4");
+    CHECK(document.parse(R"({"key": 1, "k\u0065y": 2})"));
+    CHECK(document.text(document.find(0, "key")) == "2");
+}
+
+static void test_nesting_limit() {
+    JsonDocument document;
+    string error;
+    const int limit = JsonDocument::kMaxNesting;
+    const string deepest = string(limit, '[') + string(limit, ']');
+    CHECK(document.parse(deepest));
+    CHECK(document.size() == static_cast<size_t>(limit));
+
+    const string too_deep = string(limit + 1, '[') + string(limit + 1, ']');
+    CHECK(!document.parse(too_deep, &error));
+    CHECK(error == "nesting too deep at offset " + to_string(limit));
+}
+
+static void test_errors() {
+    const struct {
+        const char* text;
+        const char* error;
+    } cases[] = {
+        {"", "unexpected end of input at offset 0"},
+        {"{", "expected a string key at offset 1"},
+        {"{\"a\"}", "expected ':' at offset 4"},
+        {"{\"a\":}", "invalid value at offset 5"},
+        {"{\"a\":1,}", "expected a string key at offset 7"},
+        {"{'a':1}", "expected a string key at offset 1"},
+        {"[1,]", "invalid value at offset 3"},
+        {"[1 2]", "expected ',' or ']' at offset 3"},
+        {"[1,2", "expected ',' or ']' at offset 4"},
+        {"01", "unexpected characters after the value at offset 1"},
+        {"1.", "invalid number at offset 2"},
+        {"1e+", "invalid number at offset 3"},
+        {"-", "invalid number at offset 1"},
+        {"tru", "invalid value at offset 0"},
+        {"{} x", "unexpected characters after the value at offset 3"},
+        {"\"abc", "unterminated string at offset 4"},
+        {"\"a\\", "unterminated string at offset 3"},
+        {"\"a\x01\"", "control character in string at offset 2"},
+        {"\"\\x\"", "invalid escape at offset 2"},
+        {"\"\\u12g4\"", "invalid \\u escape at offset 3"},
+    };
+    JsonDocument document;
+    for (const auto& c : cases) {
+        string error;
+        const bool parsed = document.parse(c.text, &error);
+        CHECK(!parsed);
+        CHECK(document.empty());
+        if (error != c.error) {
+            fprintf(stderr, "input %s: expected \"%s\", got \"%s\"\n", c.text, c.error, error.c_str());
+            failures++;
+        }
+    }
+}
+
+int main() {
+    test_structure();
+    test_strings();
+    test_duplicate_keys();
+    test_nesting_limit();
+    test_errors();
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("json_document_test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+// find_tree_subtree的测试：相对路径、根目录之下的绝对路径，以及同一前缀但不在根目录之下的路径
+#include "scan_result.hpp"
+#include "tree_text_writer.hpp"
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+// root
+// ├── base/
+// │   └── x/
+// │       └── f
+// └── g
+static ScanResult make_tree(const string& root) {
+    ScanResult result(root);
+    auto add = [&result](const char* name, bool is_directory, int depth, uint32_t parent) {
+        FileInfo info;
+        info.name = name;
+        info.is_directory = is_directory;
+        info.size = 0;
+        info.depth = depth;
+        return result.add(info, parent);
+    };
+    const uint32_t base = add("base", true, 1, ScanResult::kNoParent);
+    const uint32_t x = add("x", true, 2, base);
+    add("f", false, 3, x);
+    result.set_totals(x, SubtreeTotals{0, 1, 0});
+    result.set_totals(base, SubtreeTotals{0, 1, 1});
+    add("g", false, 1, ScanResult::kNoParent);
+    return result;
+}
+
+// 找到时返回条目下标，根目录本身为kNone，找不到为kNotFound
+static size_t resolve(const ScanResult& files, const string& path) {
+    TreeWindow window;
+    if (!find_tree_subtree(files, path, window)) {
+        return ScanResult::kNotFound;
+    }
+    return window.subtree;
+}
+
+static void test_relative() {
+    const ScanResult files = make_tree("/tmp/t/pfx");
+    CHECK(resolve(files, "base") == 0);
+    CHECK(resolve(files, "base/x") == 1);
+    CHECK(resolve(files, "./base//x/") == 1);
+    CHECK(resolve(files, "g") == 3);
+    CHECK(resolve(files, ".") == TreeWindow::kNone);
+    CHECK(resolve(files, "missing") == ScanResult::kNotFound);
+    CHECK(resolve(files, "..") == ScanResult::kNotFound);
+    CHECK(resolve(files, "../pfx/base") == ScanResult::kNotFound);
+}
+
+static void test_absolute() {
+    const ScanResult files = make_tree("/tmp/t/pfx");
+    CHECK(resolve(files, "/tmp/t/pfx") == TreeWindow::kNone);
+    CHECK(resolve(files, "/tmp/t/pfx/") == TreeWindow::kNone);
+    CHECK(resolve(files, "/tmp/t/pfx/base/x") == 1);
+
+    // 同一前缀的兄弟目录不在根目录之下，不能去掉前缀后按相对路径查找
+    CHECK(resolve(files, "/tmp/t/pfxbase/x") == ScanResult::kNotFound);
+    CHECK(resolve(files, "/tmp/t/pfxbase") == ScanResult::kNotFound);
+    // 根目录之外的绝对路径
+    CHECK(resolve(files, "/base/x") == ScanResult::kNotFound);
+    CHECK(resolve(files, "/tmp/t") == ScanResult::kNotFound);
+}
+
+static void test_root_with_separator() {
+    const ScanResult files = make_tree("/tmp/t/pfx/");
+    CHECK(resolve(files, "/tmp/t/pfx/base") == 0);
+    CHECK(resolve(files, "/tmp/t/pfx/") == TreeWindow::kNone);
+
+    const ScanResult root = make_tree("/");
+    CHECK(resolve(root, "/base/x") == 1);
+    CHECK(resolve(root, "/") == TreeWindow::kNone);
+}
+
+static void test_keeps_index() {
+    // 根目录本身不覆盖已由index给出的子树
+    const ScanResult files = make_tree("/tmp/t/pfx");
+    TreeWindow window;
+    window.subtree = 1;
+    CHECK(find_tree_subtree(files, "/tmp/t/pfx", window) && window.subtree == 1);
+}
+
+int main() {
+    test_relative();
+    test_absolute();
+    test_root_with_separator();
+    test_keeps_index();
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("tree_window_test: all checks passed\n");
+    return 0;
+}